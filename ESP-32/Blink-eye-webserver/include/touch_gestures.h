@@ -0,0 +1,49 @@
+#ifndef TOUCH_GESTURES_H
+#define TOUCH_GESTURES_H
+
+#include <Arduino.h>
+#include <driver/touch_pad.h>
+
+// Timing (ms)
+#define TOUCH_SCAN_INTERVAL 20  // How often the FSM results are read
+#define TOUCH_FILTER_PERIOD 10  // Driver filter task period, keeps the raw results updated
+#define TOUCH_TAP_MAX 300       // Longer presses are not taps
+#define TOUCH_DOUBLE_TAP_GAP 250
+#define TOUCH_LONG_PRESS 800
+#define TOUCH_SWIPE_STEP 250    // Max time between neighbouring pads in a swipe
+#define TOUCH_SWIPE_MIN_PADS 3
+
+// Thresholds, relative to each channel's own baseline
+#define TOUCH_PRESS_DROP 8      // Pressed when the reading falls 1/8 below baseline
+#define TOUCH_RELEASE_DROP 16   // Released when back within 1/16 of baseline
+#define TOUCH_BASELINE_SHIFT 6  // Baseline follows drift with weight 1/64
+#define TOUCH_MAX_CHANNELS 10
+#define TOUCH_EVENT_QUEUE 8
+
+enum GestureType : uint8_t
+{
+  GESTURE_TAP,
+  GESTURE_DOUBLE_TAP,
+  GESTURE_LONG_PRESS,
+  GESTURE_SWIPE_LEFT, // Towards the first configured pad
+  GESTURE_SWIPE_RIGHT // Towards the last configured pad
+};
+
+struct GestureEvent
+{
+  GestureType type;
+  uint8_t pad; // Index into the configured pad list; for swipes, the pad that completed it
+};
+
+// pads are ordered left to right, swipes are detected along that order.
+// Returns false if the touch driver failed or a pad gave no first reading.
+bool gesturesBegin(const touch_pad_t *pads, uint8_t count);
+void gesturesScan();
+bool gesturesNext(GestureEvent &event);
+const char *gestureName(GestureType type);
+
+// Duration of the last scan and the worst one seen, in microseconds
+uint32_t gesturesLastScanMicros();
+uint32_t gesturesMaxScanMicros();
+
+#endif
@@ -3,6 +3,7 @@
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
+#include "touch_gestures.h"
 
 // WiFi credentials
 const char *ssid = "Ravi4G";
@@ -12,23 +13,31 @@ const char *password = "Ravi4321";
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
 
-// Touch setup
-const int touchPin = T0; // GPIO 4
-const int touchThreshold = 30;
+// Touch setup, left to right (swipes follow this order)
+const touch_pad_t touchPads[] = {
+    TOUCH_PAD_NUM0, // T0, GPIO 4
+    TOUCH_PAD_NUM4, // T4, GPIO 13
+    TOUCH_PAD_NUM6, // T6, GPIO 14
+    TOUCH_PAD_NUM7, // T7, GPIO 27
+};
 
-bool lastTouch = false;
 unsigned long lastWiFiCheck = 0;
 
-// Send message to WebSocket clients
-void notifyBlink()
+// Send gesture to WebSocket clients, e.g. {"gesture":"tap","pad":0}
+void notifyGesture(const GestureEvent &event)
 {
-  ws.textAll("blink");
+  char message[48];
+  snprintf(message, sizeof(message), "{\"gesture\":\"%s\",\"pad\":%u}", gestureName(event.type), event.pad);
+  ws.textAll(message);
 }
 
 void setup()
 {
   Serial.begin(115200);
 
+  if (!gesturesBegin(touchPads, sizeof(touchPads) / sizeof(touchPads[0])))
+    Serial.println("Touch pads not ready, gestures may be missing");
+
   // Initialize SPIFFS
   if (!SPIFFS.begin(true))
   {
@@ -71,19 +80,16 @@ void setup()
 
 void loop()
 {
-  // Read touch
-  int t = touchRead(touchPin);
-  bool isTouched = t < touchThreshold;
+  // Read touch pads and publish any recognised gestures
+  gesturesScan();
 
-  // On new touch, notify via WebSocket
-  if (isTouched && !lastTouch)
+  GestureEvent event;
+  while (gesturesNext(event))
   {
-    Serial.println("Touch detected: blink!");
-    notifyBlink();
+    Serial.printf("Gesture: %s on pad %u\n", gestureName(event.type), event.pad);
+    notifyGesture(event);
   }
 
-  lastTouch = isTouched;
-
   // Re-check WiFi every 5 seconds
   if (millis() - lastWiFiCheck > 5000)
   {
@@ -97,8 +103,9 @@ void loop()
     else
     {
       Serial.println("WiFi OK. IP: " + WiFi.localIP().toString());
+      Serial.printf("Touch scan: %u us last, %u us max\n", gesturesLastScanMicros(), gesturesMaxScanMicros());
     }
   }
 
-  delay(50);
+  delay(5); // Scans are paced by TOUCH_SCAN_INTERVAL, not by this delay
 }
@@ -0,0 +1,276 @@
+#include "touch_gestures.h"
+
+enum ChannelState : uint8_t
+{
+  CH_IDLE,
+  CH_PRESSED,
+  CH_LONG_HELD,
+  CH_WAIT_SECOND, // Released after a tap, waiting to see if a second one follows
+  CH_SUPPRESSED   // Consumed by a double tap or swipe, ignore until released
+};
+
+// 8 bytes per channel, all channels in one array so a scan stays in a cache line or two
+struct TouchChannel
+{
+  uint16_t baseline; // Untouched reading << 4
+  uint16_t since;    // Low 16 bits of millis() at the last state change
+  uint8_t pad;       // touch_pad_t
+  uint8_t state;     // ChannelState
+  uint8_t touched;
+  uint8_t reserved;
+};
+
+static TouchChannel channels[TOUCH_MAX_CHANNELS];
+static uint8_t channelCount = 0;
+
+static GestureEvent events[TOUCH_EVENT_QUEUE];
+static uint8_t eventHead = 0;
+static uint8_t eventCount = 0;
+
+static struct
+{
+  int8_t lastPad;
+  int8_t direction;
+  uint8_t length;
+  uint16_t lastPress;
+} swipe = {-1, 0, 0, 0};
+
+static unsigned long lastScan = 0;
+static uint32_t lastScanMicros = 0;
+static uint32_t maxScanMicros = 0;
+
+// All durations we track are well under 65 s, so 16-bit timestamps are enough
+static inline uint16_t elapsed(uint16_t now, uint16_t since)
+{
+  return (uint16_t)(now - since);
+}
+
+static void emit(GestureType type, uint8_t pad)
+{
+  if (eventCount == TOUCH_EVENT_QUEUE)
+    return; // Nobody is draining the queue, drop the newest
+  events[(eventHead + eventCount) % TOUCH_EVENT_QUEUE] = {type, pad};
+  eventCount++;
+}
+
+// A pad was pressed recently enough that a neighbour may still continue a
+// swipe. Taps wait this out: the swipe suppresses them if it completes.
+static bool swipePending(uint16_t now)
+{
+  return swipe.length >= 1 && elapsed(now, swipe.lastPress) <= TOUCH_SWIPE_STEP;
+}
+
+static void trackSwipe(uint8_t index, uint16_t now)
+{
+  int8_t step = (int8_t)index - swipe.lastPad;
+  if (swipe.lastPad >= 0 && elapsed(now, swipe.lastPress) <= TOUCH_SWIPE_STEP && (step == 1 || step == -1))
+  {
+    if (swipe.length > 1 && step != swipe.direction)
+      swipe.length = 1; // Changed direction, start over from the previous pad
+    swipe.direction = step;
+    swipe.length++;
+  }
+  else
+  {
+    swipe.length = 1;
+  }
+  swipe.lastPad = index;
+  swipe.lastPress = now;
+
+  uint8_t needed = channelCount < TOUCH_SWIPE_MIN_PADS ? channelCount : TOUCH_SWIPE_MIN_PADS;
+  if (needed < 2 || swipe.length < needed)
+    return;
+
+  if (swipe.length > needed)
+  {
+    // Swipe already reported, this pad just continues it
+    channels[index].state = CH_SUPPRESSED;
+    return;
+  }
+
+  emit(swipe.direction > 0 ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT, index);
+
+  // The pads we slid across must not also report taps
+  for (uint8_t i = 0; i < channelCount; i++)
+    channels[i].state = channels[i].touched ? CH_SUPPRESSED : CH_IDLE;
+}
+
+static void onPress(uint8_t index, uint16_t now)
+{
+  TouchChannel &ch = channels[index];
+
+  // A tap held back by a swipe candidate that never completed
+  if (ch.state == CH_WAIT_SECOND && elapsed(now, ch.since) > TOUCH_DOUBLE_TAP_GAP)
+    emit(GESTURE_TAP, index);
+
+  if (ch.state == CH_WAIT_SECOND && elapsed(now, ch.since) <= TOUCH_DOUBLE_TAP_GAP)
+  {
+    emit(GESTURE_DOUBLE_TAP, index);
+    ch.state = CH_SUPPRESSED;
+  }
+  else
+  {
+    ch.state = CH_PRESSED;
+  }
+  ch.since = now;
+
+  trackSwipe(index, now);
+}
+
+static void onRelease(uint8_t index, uint16_t now)
+{
+  TouchChannel &ch = channels[index];
+
+  if (ch.state == CH_PRESSED && elapsed(now, ch.since) <= TOUCH_TAP_MAX)
+    ch.state = CH_WAIT_SECOND;
+  else
+    ch.state = CH_IDLE;
+  ch.since = now;
+}
+
+static void onHold(uint8_t index, uint16_t now)
+{
+  TouchChannel &ch = channels[index];
+
+  if (ch.state == CH_PRESSED && elapsed(now, ch.since) >= TOUCH_LONG_PRESS)
+  {
+    emit(GESTURE_LONG_PRESS, index);
+    ch.state = CH_LONG_HELD;
+  }
+  else if (ch.state == CH_WAIT_SECOND && elapsed(now, ch.since) > TOUCH_DOUBLE_TAP_GAP && !swipePending(now))
+  {
+    emit(GESTURE_TAP, index);
+    ch.state = CH_IDLE;
+  }
+}
+
+// Latest FSM result for the pad; false if the driver had nothing valid
+static bool readChannel(const TouchChannel &ch, uint16_t &value)
+{
+  uint16_t raw = 0;
+  if (touch_pad_read_raw_data((touch_pad_t)ch.pad, &raw) != ESP_OK || raw == 0)
+    return false;
+  value = raw > 4095 ? 4095 : raw;
+  return true;
+}
+
+bool gesturesBegin(const touch_pad_t *pads, uint8_t count)
+{
+  channelCount = count > TOUCH_MAX_CHANNELS ? TOUCH_MAX_CHANNELS : count;
+
+  // The touch FSM measures every configured pad on its own timer; scans only
+  // read the latest results, so they never wait on a measurement. The raw
+  // results are only kept up to date once the driver's filter task runs.
+  if (touch_pad_init() != ESP_OK)
+    return false;
+  touch_pad_set_voltage(TOUCH_HVOLT_2V7, TOUCH_LVOLT_0V5, TOUCH_HVOLT_ATTEN_1V);
+  touch_pad_set_fsm_mode(TOUCH_FSM_MODE_TIMER);
+  bool ok = true;
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    ok &= touch_pad_config(pads[i], 0) == ESP_OK;
+    channels[i] = {0, 0, (uint8_t)pads[i], CH_IDLE, 0, 0};
+  }
+  if (touch_pad_filter_start(TOUCH_FILTER_PERIOD) != ESP_OK)
+    return false;
+
+  // Let the FSM complete a few sweeps before taking the first baseline. A pad
+  // that cannot be read yet keeps baseline 0 and is seeded by the first good
+  // read in gesturesScan().
+  delay(100);
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    uint16_t value;
+    if (readChannel(channels[i], value))
+      channels[i].baseline = value << 4;
+    else
+      ok = false;
+  }
+  return ok;
+}
+
+void gesturesScan()
+{
+  unsigned long nowMs = millis();
+  if (nowMs - lastScan < TOUCH_SCAN_INTERVAL)
+    return;
+  lastScan = nowMs;
+
+  uint32_t start = micros();
+  uint16_t now = (uint16_t)nowMs;
+
+  for (uint8_t i = 0; i < channelCount; i++)
+  {
+    TouchChannel &ch = channels[i];
+    uint16_t value;
+    if (!readChannel(ch, value))
+      continue; // Keep the last state rather than act on a bad reading
+    value <<= 4;
+    if (ch.baseline == 0)
+    {
+      ch.baseline = value;
+      continue;
+    }
+
+    // A touch lowers the reading; release needs a smaller drop (hysteresis)
+    uint16_t threshold = ch.baseline - ch.baseline / (ch.touched ? TOUCH_RELEASE_DROP : TOUCH_PRESS_DROP);
+    bool touched = value < threshold;
+
+    if (touched == (bool)ch.touched)
+    {
+      // Follow slow drift (temperature, humidity) only while untouched
+      if (!touched)
+        ch.baseline += ((int32_t)value - ch.baseline) >> TOUCH_BASELINE_SHIFT;
+      onHold(i, now);
+      continue;
+    }
+
+    ch.touched = touched;
+    if (touched)
+      onPress(i, now);
+    else
+      onRelease(i, now);
+  }
+
+  lastScanMicros = micros() - start;
+  if (lastScanMicros > maxScanMicros)
+    maxScanMicros = lastScanMicros;
+}
+
+bool gesturesNext(GestureEvent &event)
+{
+  if (eventCount == 0)
+    return false;
+  event = events[eventHead];
+  eventHead = (eventHead + 1) % TOUCH_EVENT_QUEUE;
+  eventCount--;
+  return true;
+}
+
+const char *gestureName(GestureType type)
+{
+  switch (type)
+  {
+  case GESTURE_TAP:
+    return "tap";
+  case GESTURE_DOUBLE_TAP:
+    return "double_tap";
+  case GESTURE_LONG_PRESS:
+    return "long_press";
+  case GESTURE_SWIPE_LEFT:
+    return "swipe_left";
+  case GESTURE_SWIPE_RIGHT:
+    return "swipe_right";
+  }
+  return "unknown";
+}
+
+uint32_t gesturesLastScanMicros()
+{
+  return lastScanMicros;
+}
+
+uint32_t gesturesMaxScanMicros()
+{
+  return maxScanMicros;
+}
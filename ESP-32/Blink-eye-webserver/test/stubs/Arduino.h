@@ -0,0 +1,16 @@
+// Host stand-in for the parts of the ESP32 Arduino core the gesture engine uses.
+// Time is simulated: tests move fakeMicros forward, delay() advances it.
+#ifndef STUB_ARDUINO_H
+#define STUB_ARDUINO_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+inline uint32_t fakeMicros = 0;
+inline uint32_t micros() { return fakeMicros; }
+inline unsigned long millis() { return fakeMicros / 1000; }
+inline void delay(unsigned long ms) { fakeMicros += ms * 1000; }
+
+#endif
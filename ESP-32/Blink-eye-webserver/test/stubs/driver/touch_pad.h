@@ -0,0 +1,61 @@
+// Host stand-in for the legacy ESP32 touch driver. Each pad reports whatever
+// the test puts in fakeTouchValue, but like the real driver the raw results
+// are only filled in once the filter task has been started.
+#ifndef STUB_TOUCH_PAD_H
+#define STUB_TOUCH_PAD_H
+
+#include <cstdint>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+
+enum touch_pad_t
+{
+  TOUCH_PAD_NUM0,
+  TOUCH_PAD_NUM1,
+  TOUCH_PAD_NUM2,
+  TOUCH_PAD_NUM3,
+  TOUCH_PAD_NUM4,
+  TOUCH_PAD_NUM5,
+  TOUCH_PAD_NUM6,
+  TOUCH_PAD_NUM7,
+  TOUCH_PAD_NUM8,
+  TOUCH_PAD_NUM9,
+  TOUCH_PAD_MAX
+};
+
+enum touch_high_volt_t { TOUCH_HVOLT_2V7 };
+enum touch_low_volt_t { TOUCH_LVOLT_0V5 };
+enum touch_volt_atten_t { TOUCH_HVOLT_ATTEN_1V };
+enum touch_fsm_mode_t { TOUCH_FSM_MODE_TIMER };
+
+inline uint16_t fakeTouchValue[TOUCH_PAD_MAX];
+inline bool fakeTouchFail[TOUCH_PAD_MAX]; // Reads of this pad return ESP_FAIL
+inline bool fakeFilterStarted = false;
+inline uint32_t fakeTouchReads = 0;
+
+inline esp_err_t touch_pad_init() { return ESP_OK; }
+inline esp_err_t touch_pad_set_voltage(touch_high_volt_t, touch_low_volt_t, touch_volt_atten_t) { return ESP_OK; }
+inline esp_err_t touch_pad_set_fsm_mode(touch_fsm_mode_t) { return ESP_OK; }
+inline esp_err_t touch_pad_config(touch_pad_t, uint16_t) { return ESP_OK; }
+
+inline esp_err_t touch_pad_filter_start(uint32_t)
+{
+  fakeFilterStarted = true;
+  return ESP_OK;
+}
+
+inline esp_err_t touch_pad_read_raw_data(touch_pad_t pad, uint16_t *value)
+{
+  fakeTouchReads++;
+  if (!fakeFilterStarted)
+    return ESP_ERR_INVALID_STATE;
+  if (fakeTouchFail[pad])
+    return ESP_FAIL;
+  *value = fakeTouchValue[pad];
+  return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,304 @@
+// Replays synthetic touch traces through the gesture engine and checks that
+// every gesture is classified as what was performed, with nothing extra.
+// Timings are drawn at random within the limits a person would use, with
+// sensor noise and slow baseline drift on top. The stub micros() only moves
+// with simulated time, so the cost of each scan is taken from the host clock.
+//
+//   pio test -e native -f test_gestures -v
+
+#include <chrono>
+#include <cmath>
+#include <unity.h>
+#include <vector>
+
+#include "../../src/touch_gestures.cpp"
+
+#define PAD_COUNT 4
+#define UNTOUCHED 1000 // Raw counts, a finger brings it down to TOUCHED
+#define TOUCHED 650
+#define NOISE 12
+#define DRIFT 40       // Baseline swing over DRIFT_PERIOD_MS
+#define DRIFT_PERIOD_MS 60000
+#define SIM_STEP_MS 5
+#define PER_CLASS 200
+
+static const touch_pad_t pads[PAD_COUNT] = {TOUCH_PAD_NUM0, TOUCH_PAD_NUM4, TOUCH_PAD_NUM6, TOUCH_PAD_NUM7};
+
+struct Contact
+{
+  uint8_t pad; // Index into pads
+  uint32_t start;
+  uint32_t end;
+};
+
+enum Class : uint8_t
+{
+  CLASS_TAP,
+  CLASS_DOUBLE_TAP,
+  CLASS_LONG_PRESS,
+  CLASS_SWIPE,
+  CLASS_SLOW_SWIPE, // Steps just under TOUCH_SWIPE_STEP
+  CLASS_COUNT
+};
+
+static const char *className[CLASS_COUNT] = {"tap", "double tap", "long press", "swipe", "slow swipe"};
+
+static uint32_t seed = 1;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi)
+{
+  seed = seed * 1103515245 + 12345;
+  return lo + (seed >> 8) % (hi - lo + 1);
+}
+
+static uint32_t nowMs() { return fakeMicros / 1000; }
+
+// Host time spent in scans that read the pads (not the early returns)
+static uint32_t scans = 0;
+static std::chrono::nanoseconds scanTotal{0}, scanMax{0};
+
+// Runs the scan loop until `until`, with the given contacts held down
+static void play(const std::vector<Contact> &contacts, uint32_t until)
+{
+  while (nowMs() < until)
+  {
+    uint32_t t = nowMs();
+    int drift = lround(DRIFT * sin(2 * M_PI * t / DRIFT_PERIOD_MS));
+    for (uint8_t i = 0; i < PAD_COUNT; i++)
+    {
+      bool down = false;
+      for (const Contact &c : contacts)
+        down |= c.pad == i && t >= c.start && t < c.end;
+      fakeTouchValue[pads[i]] = (down ? TOUCHED : UNTOUCHED + drift) + (int)rnd(0, 2 * NOISE) - NOISE;
+    }
+    unsigned long before = lastScan;
+    auto start = std::chrono::steady_clock::now();
+    gesturesScan();
+    std::chrono::nanoseconds took = std::chrono::steady_clock::now() - start;
+    if (lastScan != before)
+    {
+      scans++;
+      scanTotal += took;
+      scanMax = took > scanMax ? took : scanMax;
+    }
+    fakeMicros += SIM_STEP_MS * 1000;
+  }
+}
+
+static std::vector<GestureEvent> drain()
+{
+  std::vector<GestureEvent> out;
+  GestureEvent e;
+  while (gesturesNext(e))
+    out.push_back(e);
+  return out;
+}
+
+// Builds one gesture starting at t0; fills in what it should be reported as
+static std::vector<Contact> makeGesture(Class cls, uint32_t t0, GestureEvent &expected, uint32_t &end)
+{
+  std::vector<Contact> c;
+  uint8_t pad = rnd(0, PAD_COUNT - 1);
+
+  switch (cls)
+  {
+  case CLASS_TAP:
+    c.push_back({pad, t0, t0 + rnd(40, 250)});
+    expected = {GESTURE_TAP, pad};
+    break;
+
+  case CLASS_DOUBLE_TAP:
+  {
+    uint32_t up = t0 + rnd(50, 150);
+    uint32_t down = up + rnd(50, 200);
+    c.push_back({pad, t0, up});
+    c.push_back({pad, down, down + rnd(50, 150)});
+    expected = {GESTURE_DOUBLE_TAP, pad};
+    break;
+  }
+
+  case CLASS_LONG_PRESS:
+    c.push_back({pad, t0, t0 + rnd(900, 1600)});
+    expected = {GESTURE_LONG_PRESS, pad};
+    break;
+
+  case CLASS_SWIPE:
+  case CLASS_SLOW_SWIPE:
+  {
+    uint8_t length = rnd(TOUCH_SWIPE_MIN_PADS, PAD_COUNT);
+    bool right = rnd(0, 1);
+    uint8_t first = right ? rnd(0, PAD_COUNT - length) : rnd(length - 1, PAD_COUNT - 1);
+    uint32_t t = t0;
+    for (uint8_t k = 0; k < length; k++)
+    {
+      uint8_t p = right ? first + k : first - k;
+      c.push_back({p, t, t + rnd(60, 180)});
+      // One scan interval of slack below the limit, presses are seen on a 20 ms grid
+      t += cls == CLASS_SLOW_SWIPE ? rnd(190, TOUCH_SWIPE_STEP - TOUCH_SCAN_INTERVAL - 5) : rnd(60, 180);
+    }
+    // Reported as soon as enough pads are crossed, further pads only continue it
+    expected = {right ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT, c[TOUCH_SWIPE_MIN_PADS - 1].pad};
+    break;
+  }
+
+  default:
+    TEST_FAIL_MESSAGE("unknown gesture class");
+    break;
+  }
+
+  end = t0;
+  for (const Contact &k : c)
+    end = k.end > end ? k.end : end;
+  return c;
+}
+
+void setUp()
+{
+  fakeMicros = 0;
+  fakeFilterStarted = false;
+  memset(fakeTouchFail, 0, sizeof(fakeTouchFail));
+  for (uint16_t &v : fakeTouchValue)
+    v = UNTOUCHED;
+  swipe = {-1, 0, 0, 0};
+  eventCount = 0;
+  TEST_ASSERT_TRUE(gesturesBegin(pads, PAD_COUNT));
+}
+
+void tearDown() {}
+
+void test_begin_starts_filter_and_takes_baseline()
+{
+  TEST_ASSERT_TRUE(fakeFilterStarted);
+  for (uint8_t i = 0; i < PAD_COUNT; i++)
+    TEST_ASSERT_EQUAL(UNTOUCHED << 4, channels[i].baseline);
+}
+
+void test_failed_read_does_not_set_baseline()
+{
+  fakeTouchFail[pads[1]] = true;
+  TEST_ASSERT_FALSE(gesturesBegin(pads, PAD_COUNT));
+  TEST_ASSERT_EQUAL(0, channels[1].baseline);
+
+  // Still failing: the pad is skipped, not treated as pressed
+  play({}, nowMs() + 200);
+  TEST_ASSERT_EQUAL(0, channels[1].baseline);
+
+  fakeTouchFail[pads[1]] = false;
+  play({}, nowMs() + 100);
+  TEST_ASSERT_INT_WITHIN(NOISE << 4, UNTOUCHED << 4, channels[1].baseline);
+
+  uint32_t t = nowMs();
+  play({{1, t, t + 100}}, t + 800);
+  std::vector<GestureEvent> got = drain();
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL(GESTURE_TAP, got[0].type);
+  TEST_ASSERT_EQUAL(1, got[0].pad);
+}
+
+void test_read_errors_while_held_do_not_release()
+{
+  uint32_t t = nowMs();
+  std::vector<Contact> hold = {{2, t, t + 1200}};
+  play(hold, t + 300);
+  fakeTouchFail[pads[2]] = true;
+  play(hold, t + 400);
+  fakeTouchFail[pads[2]] = false;
+  play(hold, t + 2000);
+
+  std::vector<GestureEvent> got = drain();
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL(GESTURE_LONG_PRESS, got[0].type);
+}
+
+// Short contacts with steps close to TOUCH_SWIPE_STEP: the first pad's
+// double-tap window runs out before the swipe completes
+void test_slow_swipe_has_no_leading_tap()
+{
+  uint32_t t = nowMs();
+  play({{0, t, t + 60}, {1, t + 220, t + 280}, {2, t + 440, t + 500}}, t + 1200);
+
+  std::vector<GestureEvent> got = drain();
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL(GESTURE_SWIPE_RIGHT, got[0].type);
+  TEST_ASSERT_EQUAL(2, got[0].pad);
+}
+
+// Two neighbouring taps look like the start of a swipe; both still report
+void test_unfinished_swipe_reports_held_taps()
+{
+  uint32_t t = nowMs();
+  play({{1, t, t + 80}, {2, t + 200, t + 280}}, t + 1000);
+
+  std::vector<GestureEvent> got = drain();
+  TEST_ASSERT_EQUAL(2, got.size());
+  TEST_ASSERT_EQUAL(GESTURE_TAP, got[0].type);
+  TEST_ASSERT_EQUAL(1, got[0].pad);
+  TEST_ASSERT_EQUAL(GESTURE_TAP, got[1].type);
+  TEST_ASSERT_EQUAL(2, got[1].pad);
+}
+
+void test_classification_accuracy()
+{
+  uint32_t total[CLASS_COUNT] = {};
+  uint32_t correct[CLASS_COUNT] = {};
+  uint32_t extra[CLASS_COUNT] = {};
+  scans = 0;
+  scanTotal = scanMax = std::chrono::nanoseconds(0);
+
+  // Interleave the classes so each gesture follows a different one
+  for (uint32_t n = 0; n < PER_CLASS * CLASS_COUNT; n++)
+  {
+    Class cls = (Class)rnd(0, CLASS_COUNT - 1);
+    GestureEvent expected = {};
+    uint32_t end = 0;
+    uint32_t t0 = nowMs() + 20;
+    std::vector<Contact> contacts = makeGesture(cls, t0, expected, end);
+
+    // Quiet time after the gesture covers the tap and swipe windows
+    play(contacts, end + rnd(600, 900));
+    std::vector<GestureEvent> got = drain();
+
+    total[cls]++;
+    if (got.size() >= 1 && got[0].type == expected.type && got[0].pad == expected.pad)
+      correct[cls]++;
+    if (got.size() > 1)
+      extra[cls] += got.size() - 1;
+  }
+
+  char msg[120];
+  uint32_t allCorrect = 0, allTotal = 0, allExtra = 0;
+  for (uint8_t c = 0; c < CLASS_COUNT; c++)
+  {
+    snprintf(msg, sizeof(msg), "%-11s %3u/%3u correct, %u extra events", className[c], correct[c], total[c], extra[c]);
+    TEST_MESSAGE(msg);
+    allCorrect += correct[c];
+    allTotal += total[c];
+    allExtra += extra[c];
+  }
+  snprintf(msg, sizeof(msg), "overall %.1f %% over %u gestures, %u s simulated", 100.0 * allCorrect / allTotal,
+           allTotal, nowMs() / 1000);
+  TEST_MESSAGE(msg);
+  double meanUs = scanTotal.count() / 1000.0 / scans;
+  snprintf(msg, sizeof(msg), "scan %.2f us mean, %.1f us max over %u scans of %u pads (host clock)", meanUs,
+           scanMax.count() / 1000.0, scans, PAD_COUNT);
+  TEST_MESSAGE(msg);
+
+  TEST_ASSERT_EQUAL(allTotal, allCorrect);
+  // One scan per TOUCH_SCAN_INTERVAL, give or take the grid each gesture starts on
+  TEST_ASSERT_INT_WITHIN(scans / 100, nowMs() / TOUCH_SCAN_INTERVAL, scans);
+  // Generous for a host, the point is to catch a scan that grows with history
+  TEST_ASSERT_LESS_THAN(50.0, meanUs);
+  TEST_ASSERT_EQUAL(0, allExtra);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_begin_starts_filter_and_takes_baseline);
+  RUN_TEST(test_failed_read_does_not_set_baseline);
+  RUN_TEST(test_read_errors_while_held_do_not_release);
+  RUN_TEST(test_slow_swipe_has_no_leading_tap);
+  RUN_TEST(test_unfinished_swipe_reports_held_taps);
+  RUN_TEST(test_classification_accuracy);
+  return UNITY_END();
+}
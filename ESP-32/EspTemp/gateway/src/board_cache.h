@@ -0,0 +1,109 @@
+#ifndef GATEWAY_BOARD_CACHE_H
+#define GATEWAY_BOARD_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define HISTORY_LENGTH 64 // Samples kept per board (6.4 s at the board's 100ms rate)
+
+enum BoardStatus : uint8_t
+{
+  BOARD_OFFLINE = 0,
+  BOARD_OK = 1,
+  BOARD_SENSOR_ERROR = 2
+};
+
+// Latest value and short history for every board, stored column by column so
+// a broadcast tick only walks the arrays it actually needs.
+class BoardCache
+{
+public:
+  explicit BoardCache(size_t boardCount)
+      : latest(boardCount, 0.0f), status(boardCount, BOARD_OFFLINE),
+        updatedMs(boardCount, 0), history(boardCount * HISTORY_LENGTH, 0.0f),
+        historyHead(boardCount, 0), historyCount(boardCount, 0),
+        dirty((boardCount + 63) / 64, 0)
+  {
+  }
+
+  size_t size() const { return latest.size(); }
+
+  void update(size_t board, float temperature, int64_t nowMs)
+  {
+    latest[board] = temperature;
+    status[board] = BOARD_OK;
+    updatedMs[board] = nowMs;
+
+    float *ring = &history[board * HISTORY_LENGTH];
+    ring[historyHead[board]] = temperature;
+    historyHead[board] = (uint16_t)((historyHead[board] + 1) % HISTORY_LENGTH);
+    if (historyCount[board] < HISTORY_LENGTH)
+      historyCount[board]++;
+    markDirty(board);
+  }
+
+  void setStatus(size_t board, BoardStatus newStatus, int64_t nowMs)
+  {
+    if (status[board] == newStatus)
+      return;
+    status[board] = newStatus;
+    updatedMs[board] = nowMs;
+    markDirty(board);
+  }
+
+  bool anyDirty() const
+  {
+    for (uint64_t word : dirty)
+      if (word)
+        return true;
+    return false;
+  }
+
+  // Calls fn(board) for every board changed since the last call, then clears the set
+  template <typename Fn>
+  void drainDirty(Fn fn)
+  {
+    for (size_t w = 0; w < dirty.size(); w++)
+    {
+      uint64_t word = dirty[w];
+      dirty[w] = 0;
+      while (word)
+      {
+        int bit = __builtin_ctzll(word);
+        fn(w * 64 + bit);
+        word &= word - 1;
+      }
+    }
+  }
+
+  // Oldest-first copy of a board's history
+  std::vector<float> historyOf(size_t board) const
+  {
+    std::vector<float> out;
+    uint16_t count = historyCount[board];
+    out.reserve(count);
+    const float *ring = &history[board * HISTORY_LENGTH];
+    size_t start = (historyHead[board] + HISTORY_LENGTH - count) % HISTORY_LENGTH;
+    for (uint16_t i = 0; i < count; i++)
+      out.push_back(ring[(start + i) % HISTORY_LENGTH]);
+    return out;
+  }
+
+  std::vector<float> latest;
+  std::vector<uint8_t> status;
+  std::vector<int64_t> updatedMs;
+
+private:
+  void markDirty(size_t board)
+  {
+    dirty[board / 64] |= 1ULL << (board % 64);
+  }
+
+  std::vector<float> history; // HISTORY_LENGTH floats per board, back to back
+  std::vector<uint16_t> historyHead;
+  std::vector<uint16_t> historyCount;
+  std::vector<uint64_t> dirty;
+};
+
+#endif
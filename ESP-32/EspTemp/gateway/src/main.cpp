@@ -0,0 +1,938 @@
+// EspTemp fleet gateway
+//
+// Keeps exactly one WebSocket open to every board's /ws endpoint and fans the
+// readings out to any number of dashboards, so a board only ever sees one
+// client no matter how many people are watching.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "board_cache.h"
+#include "websocket.h"
+
+// Defaults, all overridable from the command line
+#define DEFAULT_LISTEN_PORT 8080
+#define DEFAULT_BOARD_PORT 80
+#define DEFAULT_BROADCAST_INTERVAL 100 // ms, same rate the boards sample at
+#define DEFAULT_MAX_CLIENTS 4096
+
+#define BOARD_STALE_TIMEOUT 5000       // ms without a frame before we reconnect
+#define BOARD_RETRY_MIN 1000           // ms, first reconnect delay
+#define BOARD_RETRY_MAX 30000          // ms, reconnect backoff ceiling
+#define CLIENT_MAX_QUEUED (256 * 1024) // bytes pending before a client is dropped
+#define MAX_HTTP_HEADER 8192
+#define MAX_WS_PAYLOAD 4096
+#define STATS_INTERVAL 10000 // ms between stats lines on stdout
+
+typedef std::shared_ptr<const std::string> SharedFrame;
+
+enum EventKind : uint32_t
+{
+  EV_LISTENER = 0,
+  EV_BOARD = 1,
+  EV_CLIENT = 2
+};
+
+enum BoardState
+{
+  BOARD_IDLE,
+  BOARD_CONNECTING,
+  BOARD_HANDSHAKE,
+  BOARD_OPEN
+};
+
+struct Board
+{
+  std::string name;
+  std::string host;
+  uint16_t port = DEFAULT_BOARD_PORT;
+  sockaddr_storage addr{};
+  socklen_t addrLen = 0;
+
+  int fd = -1;
+  BoardState state = BOARD_IDLE;
+  std::string in;
+  std::string key; // Sec-WebSocket-Key of our upgrade request
+  int64_t retryAtMs = 0;
+  int64_t lastFrameMs = 0;
+  int backoffMs = BOARD_RETRY_MIN;
+};
+
+struct Client
+{
+  int fd = -1;
+  bool upgraded = false;
+  bool closeAfterFlush = false;
+  bool wantWrite = false;
+  std::string in;
+  std::deque<SharedFrame> queue; // frames are shared between all clients
+  size_t offset = 0;             // bytes of queue.front() already sent
+  size_t queuedBytes = 0;
+};
+
+struct Stats
+{
+  uint64_t framesIn = 0;
+  uint64_t framesOut = 0;
+  uint64_t bytesOut = 0;
+  uint64_t clientsDropped = 0;
+  uint64_t alertsIn = 0;
+};
+
+// Globals
+int epollFd = -1;
+int listenFd = -1;
+std::vector<Board> boards;
+std::unique_ptr<BoardCache> cache;
+std::unordered_map<int, Client> clients;
+Stats stats;
+
+int broadcastInterval = DEFAULT_BROADCAST_INTERVAL;
+size_t maxClients = DEFAULT_MAX_CLIENTS;
+
+int64_t nowMs()
+{
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t eventTag(EventKind kind, uint32_t id)
+{
+  return ((uint64_t)kind << 32) | id;
+}
+
+void watch(int fd, uint32_t events, uint64_t tag, int op)
+{
+  epoll_event ev{};
+  ev.events = events;
+  ev.data.u64 = tag;
+  epoll_ctl(epollFd, op, fd, &ev);
+}
+
+// ---------------------------------------------------------------------------
+// JSON helpers
+// ---------------------------------------------------------------------------
+
+const char *statusName(uint8_t status)
+{
+  switch (status)
+  {
+  case BOARD_OK:
+    return "ok";
+  case BOARD_SENSOR_ERROR:
+    return "error";
+  default:
+    return "offline";
+  }
+}
+
+void appendBoardJson(std::string &out, size_t i, int64_t now)
+{
+  char buf[160];
+  uint8_t status = cache->status[i];
+  int64_t age = cache->updatedMs[i] ? now - cache->updatedMs[i] : -1;
+
+  if (status == BOARD_SENSOR_ERROR)
+    snprintf(buf, sizeof(buf), "{\"id\":%zu,\"temperature\":\"Error\",\"status\":\"error\",\"age\":%lld,\"name\":", i, (long long)age);
+  else
+    snprintf(buf, sizeof(buf), "{\"id\":%zu,\"temperature\":%.2f,\"status\":\"%s\",\"age\":%lld,\"name\":",
+             i, cache->latest[i], statusName(status), (long long)age);
+  out += buf;
+  out += '"';
+  out += boards[i].name; // names come from our own config, no escaping needed
+  out += "\"}";
+}
+
+std::string snapshotJson()
+{
+  int64_t now = nowMs();
+  std::string out = "{\"boards\":[";
+  for (size_t i = 0; i < cache->size(); i++)
+  {
+    if (i)
+      out += ',';
+    appendBoardJson(out, i, now);
+  }
+  out += "]}";
+  return out;
+}
+
+std::string historyJson(size_t board)
+{
+  std::string out = "{\"id\":" + std::to_string(board) + ",\"history\":[";
+  std::vector<float> values = cache->historyOf(board);
+  char buf[16];
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    snprintf(buf, sizeof(buf), i ? ",%.2f" : "%.2f", values[i]);
+    out += buf;
+  }
+  out += "]}";
+  return out;
+}
+
+std::string statsJson()
+{
+  size_t online = 0;
+  for (const Board &b : boards)
+    if (b.state == BOARD_OPEN)
+      online++;
+
+  char buf[320];
+  snprintf(buf, sizeof(buf),
+           "{\"boards\":%zu,\"boardsOnline\":%zu,\"clients\":%zu,\"framesIn\":%llu,"
+           "\"framesOut\":%llu,\"bytesOut\":%llu,\"clientsDropped\":%llu,\"alertsIn\":%llu}",
+           boards.size(), online, clients.size(), (unsigned long long)stats.framesIn,
+           (unsigned long long)stats.framesOut, (unsigned long long)stats.bytesOut,
+           (unsigned long long)stats.clientsDropped, (unsigned long long)stats.alertsIn);
+  return buf;
+}
+
+// Board alert frames are {"alert":"high","slot":0,"state":"raised",...}
+bool isAlert(const std::string &payload)
+{
+  return payload.compare(0, 9, "{\"alert\":") == 0 && payload.back() == '}';
+}
+
+// Board frames are {"temperature":25.3,"status":"ok"} or the "Error" variant
+bool parseReading(const std::string &payload, float &temperature, bool &sensorError)
+{
+  if (payload.find("\"status\":\"error\"") != std::string::npos)
+  {
+    sensorError = true;
+    return true;
+  }
+
+  size_t pos = payload.find("\"temperature\":");
+  if (pos == std::string::npos)
+    return false;
+
+  const char *start = payload.c_str() + pos + 14;
+  char *end = nullptr;
+  temperature = strtof(start, &end);
+  if (end == start)
+    return false;
+
+  sensorError = false;
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Downstream clients
+// ---------------------------------------------------------------------------
+
+void closeClient(int fd)
+{
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  clients.erase(fd);
+}
+
+// Returns false if the client had to be closed
+bool flushClient(Client &c)
+{
+  while (!c.queue.empty())
+  {
+    const std::string &frame = *c.queue.front();
+    ssize_t n = send(c.fd, frame.data() + c.offset, frame.size() - c.offset, MSG_NOSIGNAL);
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      closeClient(c.fd);
+      return false;
+    }
+
+    c.offset += n;
+    c.queuedBytes -= n;
+    stats.bytesOut += n;
+    if (c.offset == frame.size())
+    {
+      c.queue.pop_front();
+      c.offset = 0;
+    }
+  }
+
+  if (c.queue.empty() && c.closeAfterFlush)
+  {
+    closeClient(c.fd);
+    return false;
+  }
+
+  bool wantWrite = !c.queue.empty();
+  if (wantWrite != c.wantWrite)
+  {
+    c.wantWrite = wantWrite;
+    watch(c.fd, EPOLLIN | (wantWrite ? (uint32_t)EPOLLOUT : 0u), eventTag(EV_CLIENT, c.fd), EPOLL_CTL_MOD);
+  }
+  return true;
+}
+
+// Queue without flushing; the caller flushes once after queueing
+bool enqueue(Client &c, const SharedFrame &frame)
+{
+  if (c.queuedBytes + frame->size() > CLIENT_MAX_QUEUED)
+  {
+    // A dashboard this far behind will never catch up, let it reconnect
+    stats.clientsDropped++;
+    closeClient(c.fd);
+    return false;
+  }
+  c.queue.push_back(frame);
+  c.queuedBytes += frame->size();
+  return true;
+}
+
+void sendHttp(Client &c, int code, const char *reason, const char *type, const std::string &body)
+{
+  char header[256];
+  snprintf(header, sizeof(header),
+           "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+           "Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n",
+           code, reason, type, body.size());
+  c.closeAfterFlush = true;
+  if (enqueue(c, std::make_shared<const std::string>(header + body)))
+    flushClient(c);
+}
+
+std::string headerValue(const std::string &request, const char *name)
+{
+  size_t nameLen = strlen(name);
+  size_t pos = request.find("\r\n");
+  while (pos != std::string::npos && pos + 2 < request.size())
+  {
+    size_t lineStart = pos + 2;
+    size_t lineEnd = request.find("\r\n", lineStart);
+    if (lineEnd == std::string::npos)
+      break;
+    if (lineEnd - lineStart > nameLen && request[lineStart + nameLen] == ':' &&
+        strncasecmp(request.c_str() + lineStart, name, nameLen) == 0)
+    {
+      size_t valueStart = request.find_first_not_of(' ', lineStart + nameLen + 1);
+      return request.substr(valueStart, lineEnd - valueStart);
+    }
+    pos = lineEnd;
+  }
+  return "";
+}
+
+void handleHttpRequest(Client &c)
+{
+  size_t end = c.in.find("\r\n\r\n");
+  std::string request = c.in.substr(0, end + 4);
+  c.in.erase(0, end + 4);
+
+  char method[8] = {0}, path[256] = {0};
+  if (sscanf(request.c_str(), "%7s %255s", method, path) != 2 || strcmp(method, "GET") != 0)
+  {
+    sendHttp(c, 405, "Method Not Allowed", "text/plain", "Method not allowed");
+    return;
+  }
+
+  if (strcmp(path, "/ws") == 0)
+  {
+    std::string key = headerValue(request, "Sec-WebSocket-Key");
+    if (key.empty())
+    {
+      sendHttp(c, 400, "Bad Request", "text/plain", "Missing Sec-WebSocket-Key");
+      return;
+    }
+
+    std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                           "Connection: Upgrade\r\nSec-WebSocket-Accept: " +
+                           ws::acceptKey(key) + "\r\n\r\n";
+    c.upgraded = true;
+
+    // New dashboards get the full picture once, then only deltas
+    std::string snapshot = snapshotJson();
+    if (enqueue(c, std::make_shared<const std::string>(response)) &&
+        enqueue(c, std::make_shared<const std::string>(ws::encodeFrame(ws::OP_TEXT, snapshot.data(), snapshot.size(), false))))
+      flushClient(c);
+    return;
+  }
+
+  if (strcmp(path, "/boards") == 0)
+  {
+    sendHttp(c, 200, "OK", "application/json", snapshotJson());
+    return;
+  }
+
+  unsigned long id;
+  if (sscanf(path, "/boards/%lu/history", &id) == 1 && id < cache->size())
+  {
+    sendHttp(c, 200, "OK", "application/json", historyJson(id));
+    return;
+  }
+
+  if (strcmp(path, "/stats") == 0)
+  {
+    sendHttp(c, 200, "OK", "application/json", statsJson());
+    return;
+  }
+
+  sendHttp(c, 404, "Not Found", "text/plain", "Not found");
+}
+
+void handleClientFrames(Client &c)
+{
+  while (!c.in.empty())
+  {
+    ws::Frame frame;
+    long used = ws::decodeFrame(c.in.data(), c.in.size(), frame, MAX_WS_PAYLOAD);
+    if (used < 0)
+    {
+      closeClient(c.fd);
+      return;
+    }
+    if (used == 0)
+      break;
+    c.in.erase(0, used);
+
+    if (frame.opcode == ws::OP_CLOSE)
+    {
+      c.closeAfterFlush = true;
+      if (enqueue(c, std::make_shared<const std::string>(ws::encodeFrame(ws::OP_CLOSE, "", 0, false))))
+        flushClient(c);
+      return;
+    }
+    if (frame.opcode == ws::OP_PING)
+    {
+      if (!enqueue(c, std::make_shared<const std::string>(
+                          ws::encodeFrame(ws::OP_PONG, frame.payload.data(), frame.payload.size(), false))))
+        return;
+      if (!flushClient(c))
+        return;
+    }
+    // Dashboards have nothing to tell us, anything else is ignored
+  }
+}
+
+void onClientEvent(int fd, uint32_t events)
+{
+  auto it = clients.find(fd);
+  if (it == clients.end())
+    return;
+  Client &c = it->second;
+
+  if (events & (EPOLLERR | EPOLLHUP))
+  {
+    closeClient(fd);
+    return;
+  }
+
+  if (events & EPOLLOUT)
+  {
+    if (!flushClient(c))
+      return;
+  }
+
+  if (events & EPOLLIN)
+  {
+    char buf[4096];
+    for (;;)
+    {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+      {
+        closeClient(fd);
+        return;
+      }
+      if (n < 0)
+        break;
+      c.in.append(buf, n);
+    }
+
+    if (!c.upgraded)
+    {
+      if (c.in.find("\r\n\r\n") != std::string::npos)
+        handleHttpRequest(c);
+      else if (c.in.size() > MAX_HTTP_HEADER)
+        closeClient(fd);
+      return;
+    }
+    handleClientFrames(c);
+  }
+}
+
+void acceptClients()
+{
+  for (;;)
+  {
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+    if (fd < 0)
+      return;
+
+    if (clients.size() >= maxClients)
+    {
+      close(fd);
+      continue;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Client &c = clients[fd];
+    c.fd = fd;
+    watch(fd, EPOLLIN, eventTag(EV_CLIENT, fd), EPOLL_CTL_ADD);
+  }
+}
+
+// Queues the same frame on every dashboard
+void sendToClients(const SharedFrame &frame)
+{
+  std::vector<int> fds;
+  fds.reserve(clients.size());
+  for (auto &entry : clients)
+    if (entry.second.upgraded && !entry.second.closeAfterFlush)
+      fds.push_back(entry.first);
+
+  for (int fd : fds)
+  {
+    auto it = clients.find(fd);
+    if (it == clients.end())
+      continue;
+    if (enqueue(it->second, frame))
+    {
+      stats.framesOut++;
+      flushClient(it->second);
+    }
+  }
+}
+
+// Serialize the changed boards once and hand the same buffer to every client
+void broadcastChanges()
+{
+  if (!cache->anyDirty())
+    return;
+
+  int64_t now = nowMs();
+  std::string json = "{\"boards\":[";
+  bool first = true;
+  cache->drainDirty([&](size_t i)
+                    {
+    if (!first)
+      json += ',';
+    first = false;
+    appendBoardJson(json, i, now); });
+  json += "]}";
+
+  if (clients.empty())
+    return;
+
+  sendToClients(std::make_shared<const std::string>(ws::encodeFrame(ws::OP_TEXT, json.data(), json.size(), false)));
+}
+
+// Alerts are rare and urgent: forwarded as they arrive, not on the next tick,
+// with the board's id and name in front of the board's own fields. They are
+// not cached, a dashboard that connects later reads the board's GET /alerts.
+void forwardAlert(size_t i, const std::string &payload)
+{
+  stats.alertsIn++;
+  if (clients.empty())
+    return;
+
+  std::string json = "{\"id\":" + std::to_string(i) + ",\"name\":\"" + boards[i].name + "\"," + payload.substr(1);
+  sendToClients(std::make_shared<const std::string>(ws::encodeFrame(ws::OP_TEXT, json.data(), json.size(), false)));
+}
+
+// ---------------------------------------------------------------------------
+// Upstream boards
+// ---------------------------------------------------------------------------
+
+void disconnectBoard(size_t i, int64_t now)
+{
+  Board &b = boards[i];
+  if (b.fd >= 0)
+  {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, b.fd, nullptr);
+    close(b.fd);
+  }
+  b.fd = -1;
+  b.in.clear();
+  b.state = BOARD_IDLE;
+  b.retryAtMs = now + b.backoffMs;
+  b.backoffMs = std::min(b.backoffMs * 2, BOARD_RETRY_MAX);
+  cache->setStatus(i, BOARD_OFFLINE, now);
+}
+
+void connectBoard(size_t i, int64_t now)
+{
+  Board &b = boards[i];
+  b.fd = socket(b.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (b.fd < 0)
+  {
+    disconnectBoard(i, now);
+    return;
+  }
+
+  int one = 1;
+  setsockopt(b.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  if (connect(b.fd, (sockaddr *)&b.addr, b.addrLen) < 0 && errno != EINPROGRESS)
+  {
+    disconnectBoard(i, now);
+    return;
+  }
+
+  b.state = BOARD_CONNECTING;
+  b.lastFrameMs = now;
+  watch(b.fd, EPOLLIN | EPOLLOUT, eventTag(EV_BOARD, (uint32_t)i), EPOLL_CTL_ADD);
+}
+
+void sendToBoard(size_t i, const std::string &data, int64_t now)
+{
+  // Upstream traffic is a handshake or a tiny control frame, it always fits
+  // in an empty socket buffer, so a short write means the link is broken.
+  Board &b = boards[i];
+  if (send(b.fd, data.data(), data.size(), MSG_NOSIGNAL) != (ssize_t)data.size())
+    disconnectBoard(i, now);
+}
+
+void handleBoardFrames(size_t i, int64_t now)
+{
+  Board &b = boards[i];
+  while (!b.in.empty())
+  {
+    ws::Frame frame;
+    long used = ws::decodeFrame(b.in.data(), b.in.size(), frame, MAX_WS_PAYLOAD);
+    if (used < 0)
+    {
+      disconnectBoard(i, now);
+      return;
+    }
+    if (used == 0)
+      break;
+    b.in.erase(0, used);
+    b.lastFrameMs = now;
+
+    switch (frame.opcode)
+    {
+    case ws::OP_TEXT:
+    {
+      float temperature = 0;
+      bool sensorError = false;
+      if (isAlert(frame.payload))
+        forwardAlert(i, frame.payload);
+      else if (parseReading(frame.payload, temperature, sensorError))
+      {
+        stats.framesIn++;
+        if (sensorError)
+          cache->setStatus(i, BOARD_SENSOR_ERROR, now);
+        else
+          cache->update(i, temperature, now);
+      }
+      break;
+    }
+
+    case ws::OP_PING:
+      sendToBoard(i, ws::encodeFrame(ws::OP_PONG, frame.payload.data(), frame.payload.size(), true), now);
+      if (b.fd < 0)
+        return;
+      break;
+
+    case ws::OP_CLOSE:
+      disconnectBoard(i, now);
+      return;
+
+    default:
+      break;
+    }
+  }
+}
+
+void onBoardEvent(size_t i, uint32_t events)
+{
+  Board &b = boards[i];
+  int64_t now = nowMs();
+
+  if (b.state == BOARD_CONNECTING && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+  {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(b.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0)
+    {
+      disconnectBoard(i, now);
+      return;
+    }
+
+    b.key = ws::makeClientKey();
+    std::string request = "GET /ws HTTP/1.1\r\nHost: " + b.host + ":" + std::to_string(b.port) +
+                          "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: " +
+                          b.key + "\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    b.state = BOARD_HANDSHAKE;
+    watch(b.fd, EPOLLIN, eventTag(EV_BOARD, (uint32_t)i), EPOLL_CTL_MOD);
+    sendToBoard(i, request, now);
+    return;
+  }
+
+  if (events & (EPOLLERR | EPOLLHUP))
+  {
+    disconnectBoard(i, now);
+    return;
+  }
+
+  char buf[4096];
+  for (;;)
+  {
+    ssize_t n = recv(b.fd, buf, sizeof(buf), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+      disconnectBoard(i, now);
+      return;
+    }
+    if (n < 0)
+      break;
+    b.in.append(buf, n);
+  }
+
+  if (b.state == BOARD_HANDSHAKE)
+  {
+    size_t end = b.in.find("\r\n\r\n");
+    if (end == std::string::npos)
+    {
+      if (b.in.size() > MAX_HTTP_HEADER)
+        disconnectBoard(i, now);
+      return;
+    }
+    if (b.in.compare(0, 12, "HTTP/1.1 101") != 0)
+    {
+      fprintf(stderr, "Board %s refused the WebSocket upgrade\n", b.name.c_str());
+      disconnectBoard(i, now);
+      return;
+    }
+    if (headerValue(b.in.substr(0, end + 4), "Sec-WebSocket-Accept") != ws::acceptKey(b.key))
+    {
+      fprintf(stderr, "Board %s sent a wrong Sec-WebSocket-Accept\n", b.name.c_str());
+      disconnectBoard(i, now);
+      return;
+    }
+
+    b.in.erase(0, end + 4);
+    b.state = BOARD_OPEN;
+    b.backoffMs = BOARD_RETRY_MIN;
+    printf("Board %s connected\n", b.name.c_str());
+  }
+
+  handleBoardFrames(i, now);
+}
+
+// Reconnect boards whose backoff expired and drop ones that went silent
+void serviceBoards(int64_t now)
+{
+  for (size_t i = 0; i < boards.size(); i++)
+  {
+    Board &b = boards[i];
+    if (b.state == BOARD_IDLE)
+    {
+      if (now >= b.retryAtMs)
+        connectBoard(i, now);
+    }
+    else if (now - b.lastFrameMs > BOARD_STALE_TIMEOUT)
+    {
+      printf("Board %s went silent, reconnecting\n", b.name.c_str());
+      disconnectBoard(i, now);
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+// Accepts "name=host:port", "host:port" or "host"
+bool addBoard(const std::string &spec)
+{
+  Board b;
+  std::string target = spec;
+  size_t eq = spec.find('=');
+  if (eq != std::string::npos)
+  {
+    b.name = spec.substr(0, eq);
+    target = spec.substr(eq + 1);
+  }
+
+  size_t colon = target.rfind(':');
+  b.host = target.substr(0, colon);
+  if (colon != std::string::npos)
+    b.port = (uint16_t)atoi(target.c_str() + colon + 1);
+  if (b.name.empty())
+    b.name = target;
+
+  addrinfo hints{}, *result = nullptr;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(b.host.c_str(), std::to_string(b.port).c_str(), &hints, &result) != 0 || !result)
+  {
+    fprintf(stderr, "ERROR: cannot resolve board %s\n", spec.c_str());
+    return false;
+  }
+  memcpy(&b.addr, result->ai_addr, result->ai_addrlen);
+  b.addrLen = result->ai_addrlen;
+  freeaddrinfo(result);
+
+  boards.push_back(b);
+  return true;
+}
+
+bool loadBoardFile(const char *path)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    fprintf(stderr, "ERROR: cannot open %s\n", path);
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line[start] == '#')
+      continue;
+    size_t end = line.find_last_not_of(" \t\r");
+    if (!addBoard(line.substr(start, end - start + 1)))
+      return false;
+  }
+  return true;
+}
+
+bool startListener(uint16_t port)
+{
+  listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (listenFd < 0)
+    return false;
+
+  int one = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 1024) < 0)
+    return false;
+
+  watch(listenFd, EPOLLIN, eventTag(EV_LISTENER, 0), EPOLL_CTL_ADD);
+  return true;
+}
+
+void usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [-p port] [-i interval_ms] [-c max_clients] [-f boards.txt] [name=]host[:port]...\n"
+          "  -p  port dashboards connect to (default %d)\n"
+          "  -i  broadcast interval in ms (default %d)\n"
+          "  -c  maximum downstream clients (default %d)\n"
+          "  -f  file with one board per line\n",
+          prog, DEFAULT_LISTEN_PORT, DEFAULT_BROADCAST_INTERVAL, DEFAULT_MAX_CLIENTS);
+}
+
+int main(int argc, char **argv)
+{
+  uint16_t listenPort = DEFAULT_LISTEN_PORT;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:i:c:f:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'p':
+      listenPort = (uint16_t)atoi(optarg);
+      break;
+    case 'i':
+      broadcastInterval = std::max(1, atoi(optarg));
+      break;
+    case 'c':
+      maxClients = (size_t)std::max(1, atoi(optarg));
+      break;
+    case 'f':
+      if (!loadBoardFile(optarg))
+        return 1;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  for (int i = optind; i < argc; i++)
+    if (!addBoard(argv[i]))
+      return 1;
+
+  if (boards.empty())
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  cache.reset(new BoardCache(boards.size()));
+
+  epollFd = epoll_create1(0);
+  if (epollFd < 0 || !startListener(listenPort))
+  {
+    fprintf(stderr, "ERROR: cannot listen on port %u: %s\n", listenPort, strerror(errno));
+    return 1;
+  }
+
+  printf("=== EspTemp Gateway ===\n");
+  printf("Boards: %zu, listening on :%u, broadcast every %d ms\n", boards.size(), listenPort, broadcastInterval);
+
+  int64_t nextBroadcast = nowMs();
+  int64_t nextStats = nextBroadcast + STATS_INTERVAL;
+  serviceBoards(nextBroadcast);
+
+  std::vector<epoll_event> events(1024);
+  for (;;)
+  {
+    int64_t now = nowMs();
+    int timeout = (int)std::max<int64_t>(0, nextBroadcast - now);
+    int n = epoll_wait(epollFd, events.data(), (int)events.size(), timeout);
+
+    for (int e = 0; e < n; e++)
+    {
+      EventKind kind = (EventKind)(events[e].data.u64 >> 32);
+      uint32_t id = (uint32_t)events[e].data.u64;
+      if (kind == EV_LISTENER)
+        acceptClients();
+      else if (kind == EV_BOARD)
+        onBoardEvent(id, events[e].events);
+      else
+        onClientEvent((int)id, events[e].events);
+    }
+
+    now = nowMs();
+    if (now >= nextBroadcast)
+    {
+      broadcastChanges();
+      serviceBoards(now);
+      nextBroadcast = now + broadcastInterval;
+    }
+
+    if (now >= nextStats)
+    {
+      printf("%s\n", statsJson().c_str());
+      fflush(stdout);
+      nextStats = now + STATS_INTERVAL;
+    }
+  }
+}
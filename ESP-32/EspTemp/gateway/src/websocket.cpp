@@ -0,0 +1,222 @@
+#include "websocket.h"
+
+#include <cstring>
+#include <random>
+
+namespace
+{
+  const char *WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+  uint32_t rol(uint32_t v, int bits)
+  {
+    return (v << bits) | (v >> (32 - bits));
+  }
+
+  // Plain SHA-1, only used for the handshake
+  void sha1(const std::string &msg, uint8_t digest[20])
+  {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::string data = msg;
+    uint64_t bitLen = (uint64_t)msg.size() * 8;
+    data.push_back((char)0x80);
+    while (data.size() % 64 != 56)
+      data.push_back(0);
+    for (int i = 7; i >= 0; i--)
+      data.push_back((char)(bitLen >> (i * 8)));
+
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64)
+    {
+      uint32_t w[80];
+      for (int i = 0; i < 16; i++)
+      {
+        const uint8_t *p = (const uint8_t *)data.data() + chunk + i * 4;
+        w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+      }
+      for (int i = 16; i < 80; i++)
+        w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+      for (int i = 0; i < 80; i++)
+      {
+        uint32_t f, k;
+        if (i < 20)
+        {
+          f = (b & c) | (~b & d);
+          k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+          f = b ^ c ^ d;
+          k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+          f = (b & c) | (b & d) | (c & d);
+          k = 0x8F1BBCDC;
+        }
+        else
+        {
+          f = b ^ c ^ d;
+          k = 0xCA62C1D6;
+        }
+        uint32_t temp = rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol(b, 30);
+        b = a;
+        a = temp;
+      }
+      h[0] += a;
+      h[1] += b;
+      h[2] += c;
+      h[3] += d;
+      h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+      digest[i * 4] = (uint8_t)(h[i] >> 24);
+      digest[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+      digest[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+      digest[i * 4 + 3] = (uint8_t)h[i];
+    }
+  }
+
+  std::string base64(const uint8_t *data, size_t len)
+  {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < len; i += 3)
+    {
+      uint32_t n = (uint32_t)data[i] << 16;
+      if (i + 1 < len)
+        n |= (uint32_t)data[i + 1] << 8;
+      if (i + 2 < len)
+        n |= data[i + 2];
+      out.push_back(table[(n >> 18) & 63]);
+      out.push_back(table[(n >> 12) & 63]);
+      out.push_back(i + 1 < len ? table[(n >> 6) & 63] : '=');
+      out.push_back(i + 2 < len ? table[n & 63] : '=');
+    }
+    return out;
+  }
+
+  std::mt19937 &rng()
+  {
+    static std::mt19937 gen(std::random_device{}());
+    return gen;
+  }
+}
+
+namespace ws
+{
+  std::string acceptKey(const std::string &clientKey)
+  {
+    uint8_t digest[20];
+    sha1(clientKey + WS_GUID, digest);
+    return base64(digest, sizeof(digest));
+  }
+
+  std::string makeClientKey()
+  {
+    uint8_t key[16];
+    for (auto &b : key)
+      b = (uint8_t)rng()();
+    return base64(key, sizeof(key));
+  }
+
+  std::string encodeFrame(uint8_t opcode, const char *data, size_t len, bool mask)
+  {
+    std::string out;
+    out.reserve(len + 14);
+    out.push_back((char)(0x80 | opcode));
+
+    uint8_t maskBit = mask ? 0x80 : 0;
+    if (len < 126)
+    {
+      out.push_back((char)(maskBit | len));
+    }
+    else if (len <= 0xFFFF)
+    {
+      out.push_back((char)(maskBit | 126));
+      out.push_back((char)(len >> 8));
+      out.push_back((char)len);
+    }
+    else
+    {
+      out.push_back((char)(maskBit | 127));
+      for (int i = 7; i >= 0; i--)
+        out.push_back((char)((uint64_t)len >> (i * 8)));
+    }
+
+    if (!mask)
+    {
+      out.append(data, len);
+      return out;
+    }
+
+    uint8_t key[4];
+    for (auto &b : key)
+      b = (uint8_t)rng()();
+    out.append((const char *)key, 4);
+    for (size_t i = 0; i < len; i++)
+      out.push_back((char)(data[i] ^ key[i & 3]));
+    return out;
+  }
+
+  long decodeFrame(const char *buf, size_t len, Frame &out, size_t maxPayload)
+  {
+    const uint8_t *p = (const uint8_t *)buf;
+    if (len < 2)
+      return 0;
+
+    bool fin = p[0] & 0x80;
+    uint8_t opcode = p[0] & 0x0F;
+    bool masked = p[1] & 0x80;
+    uint64_t payloadLen = p[1] & 0x7F;
+    size_t pos = 2;
+
+    if (payloadLen == 126)
+    {
+      if (len < pos + 2)
+        return 0;
+      payloadLen = ((uint64_t)p[2] << 8) | p[3];
+      pos += 2;
+    }
+    else if (payloadLen == 127)
+    {
+      if (len < pos + 8)
+        return 0;
+      payloadLen = 0;
+      for (int i = 0; i < 8; i++)
+        payloadLen = (payloadLen << 8) | p[2 + i];
+      pos += 8;
+    }
+
+    if (payloadLen > maxPayload)
+      return -1;
+
+    uint8_t key[4] = {0, 0, 0, 0};
+    if (masked)
+    {
+      if (len < pos + 4)
+        return 0;
+      memcpy(key, p + pos, 4);
+      pos += 4;
+    }
+
+    if (len < pos + payloadLen)
+      return 0;
+
+    out.fin = fin;
+    out.opcode = opcode;
+    out.payload.assign(buf + pos, (size_t)payloadLen);
+    if (masked)
+    {
+      for (size_t i = 0; i < out.payload.size(); i++)
+        out.payload[i] ^= key[i & 3];
+    }
+    return (long)(pos + payloadLen);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef GATEWAY_WEBSOCKET_H
+#define GATEWAY_WEBSOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Minimal RFC 6455 helpers: just enough to talk to the board's AsyncWebSocket
+// on one side and to browsers on the other.
+namespace ws
+{
+  enum Opcode : uint8_t
+  {
+    OP_CONT = 0x0,
+    OP_TEXT = 0x1,
+    OP_BINARY = 0x2,
+    OP_CLOSE = 0x8,
+    OP_PING = 0x9,
+    OP_PONG = 0xA
+  };
+
+  struct Frame
+  {
+    uint8_t opcode = 0;
+    bool fin = true;
+    std::string payload;
+  };
+
+  // Sec-WebSocket-Accept value for a client's Sec-WebSocket-Key
+  std::string acceptKey(const std::string &clientKey);
+
+  // Random 16-byte key, base64 encoded, for our own upgrade requests
+  std::string makeClientKey();
+
+  // Client -> server frames must be masked, server -> client must not
+  std::string encodeFrame(uint8_t opcode, const char *data, size_t len, bool mask);
+
+  // Decode one frame from the front of buf.
+  // Returns bytes consumed, 0 if more data is needed, -1 on a protocol error.
+  long decodeFrame(const char *buf, size_t len, Frame &out, size_t maxPayload);
+}
+
+#endif
@@ -0,0 +1,349 @@
+#!/usr/bin/env python3
+"""
+Load test for the EspTemp gateway with simulated boards and dashboards.
+
+Starts N fake boards (WebSocket servers on localhost that send a reading like
+the real firmware), runs the gateway against them and connects M dashboard
+clients to its /ws endpoint. Each reading encodes the time it was sent, so
+the probe clients can measure board-to-dashboard latency. The harness runs in
+one Python process; with thousands of clients on a small machine it becomes the
+bottleneck before the gateway does, so run it on another core or host.
+
+    g++ -O2 -std=c++17 src/*.cpp -o esptemp-gateway
+    python3 tools/loadtest.py ./esptemp-gateway --boards 50 --clients 10
+    python3 tools/loadtest.py ./esptemp-gateway --boards 2000 --clients 1000
+
+After the measurement every other board drops its connection, the way a
+rebooting board would, and the harness waits for the gateway to reconnect.
+
+Checks, reported as PASS/FAIL at the end:
+  - every client's first message is a snapshot listing every board
+  - every later message seen by a probe client carries only valid board entries
+  - no client was dropped by the gateway
+  - every board had exactly one gateway connection at a time, and has one at
+    the end, including the boards that were reconnected after backoff
+"""
+
+import argparse
+import asyncio
+import base64
+import hashlib
+import json
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+
+def now_cs():
+    return int(time.monotonic() * 100)
+
+
+def encode_frame(payload):
+    header = bytes([0x81])
+    n = len(payload)
+    if n < 126:
+        header += bytes([n])
+    elif n < 65536:
+        header += bytes([126]) + struct.pack(">H", n)
+    else:
+        header += bytes([127]) + struct.pack(">Q", n)
+    return header + payload
+
+
+async def read_frame(reader):
+    b0, b1 = await reader.readexactly(2)
+    n = b1 & 0x7F
+    if n == 126:
+        (n,) = struct.unpack(">H", await reader.readexactly(2))
+    elif n == 127:
+        (n,) = struct.unpack(">Q", await reader.readexactly(8))
+    mask = await reader.readexactly(4) if b1 & 0x80 else None
+    payload = await reader.readexactly(n)
+    if mask:
+        payload = bytes(c ^ mask[i % 4] for i, c in enumerate(payload))
+    return b0 & 0x0F, payload
+
+
+class FakeBoard:
+    """One board: accepts the gateway's WebSocket and sends readings."""
+
+    def __init__(self, interval, error_rate, alert_rate):
+        self.interval = interval
+        self.error_rate = error_rate
+        self.alert_rate = alert_rate
+        self.sent = 0
+        self.alerts = []  # time.monotonic() of each alert sent
+        self.accepted = 0    # Connections accepted over the whole run
+        self.writers = set() # Open connections
+        self.max_open = 0
+
+    def kick(self):
+        """Drop every open connection, like a board rebooting."""
+        for writer in self.writers:
+            writer.close()
+
+    async def handle(self, reader, writer):
+        self.accepted += 1
+        self.writers.add(writer)
+        self.max_open = max(self.max_open, len(self.writers))
+        try:
+            request = await reader.readuntil(b"\r\n\r\n")
+            key = b""
+            for line in request.split(b"\r\n"):
+                if line.lower().startswith(b"sec-websocket-key:"):
+                    key = line.split(b":", 1)[1].strip()
+            accept = base64.b64encode(hashlib.sha1(key + GUID).digest())
+            writer.write(b"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                         b"Connection: Upgrade\r\nSec-WebSocket-Accept: " + accept + b"\r\n\r\n")
+            asyncio.ensure_future(self.drain(reader, writer))
+            # Spread boards over the interval like independent devices would be
+            await asyncio.sleep(random.random() * self.interval)
+            while not writer.is_closing():
+                if random.random() < self.error_rate:
+                    msg = b'{"temperature":"Error","status":"error"}'
+                else:
+                    # Centiseconds mod 10000 as the temperature: 0.00..99.99 "degrees"
+                    msg = b'{"temperature":%.2f,"status":"ok"}' % ((now_cs() % 10000) / 100)
+                writer.write(encode_frame(msg))
+                if random.random() < self.alert_rate:
+                    # Same layout as onAlert() in the firmware, stamped like a reading
+                    writer.write(encode_frame(b'{"alert":"high","slot":0,"state":"raised","priority":2,'
+                                              b'"value":%.2f,"threshold":35.00}' % ((now_cs() % 10000) / 100)))
+                    self.alerts.append(time.monotonic())
+                await writer.drain()
+                self.sent += 1
+                await asyncio.sleep(self.interval)
+        except (ConnectionError, asyncio.IncompleteReadError, asyncio.CancelledError):
+            pass
+        finally:
+            self.writers.discard(writer)
+            writer.close()
+
+    async def drain(self, reader, writer):
+        try:
+            while await reader.read(4096):
+                pass
+        except (ConnectionError, asyncio.CancelledError):
+            pass
+        # The gateway hung up: stop sending so the connection counts as closed
+        self.writers.discard(writer)
+        writer.close()
+
+
+class Dashboard:
+    """One dashboard client of the gateway."""
+
+    def __init__(self, board_count, probe):
+        self.board_count = board_count
+        self.probe = probe  # Parse every message; the rest only count frames
+        self.messages = 0
+        self.bytes = 0
+        self.snapshot_ok = None
+        self.bad_entries = 0
+        self.latencies = []
+        self.alerts = 0
+        self.bad_alerts = 0
+        self.alert_latencies = []
+        self.closed = False
+
+    async def run(self, port, deadline):
+        try:
+            reader, writer = await asyncio.open_connection("127.0.0.1", port)
+            key = base64.b64encode(os.urandom(16))
+            writer.write(b"GET /ws HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\n"
+                         b"Connection: Upgrade\r\nSec-WebSocket-Key: " + key +
+                         b"\r\nSec-WebSocket-Version: 13\r\n\r\n")
+            response = await reader.readuntil(b"\r\n\r\n")
+            if b" 101 " not in response.split(b"\r\n")[0]:
+                self.closed = True
+                return
+            while time.monotonic() < deadline:
+                remaining = deadline - time.monotonic()
+                opcode, payload = await asyncio.wait_for(read_frame(reader), remaining)
+                if opcode == 8:
+                    self.closed = True
+                    return
+                if opcode != 1:
+                    continue
+                if self.probe or self.snapshot_ok is None:
+                    self.check(payload, now_cs())
+                else:
+                    self.messages += 1
+                    self.bytes += len(payload)
+            writer.close()
+        except asyncio.TimeoutError:
+            pass
+        except (ConnectionError, asyncio.IncompleteReadError):
+            self.closed = True
+
+    def check(self, payload, received):
+        self.messages += 1
+        self.bytes += len(payload)
+        msg = json.loads(payload)
+        if "alert" in msg:
+            # Forwarded as it arrives, tagged with the board it came from
+            self.alerts += 1
+            if not 0 <= msg["id"] < self.board_count or msg["name"] != "board%d" % msg["id"] or self.snapshot_ok is None:
+                self.bad_alerts += 1
+            else:
+                self.alert_latencies.append(((received - round(msg["value"] * 100)) % 10000) * 10)
+            return
+        boards = msg["boards"]
+        if self.snapshot_ok is None:
+            self.snapshot_ok = len(boards) == self.board_count
+            return
+        for b in boards:
+            if not 0 <= b["id"] < self.board_count or b["status"] not in ("ok", "error", "offline"):
+                self.bad_entries += 1
+            elif b["status"] == "ok":
+                sent = round(b["temperature"] * 100)
+                self.latencies.append(((received - sent) % 10000) * 10)
+
+
+async def get_stats(port):
+    reader, writer = await asyncio.open_connection("127.0.0.1", port)
+    writer.write(b"GET /stats HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n")
+    data = await reader.read()
+    writer.close()
+    return json.loads(data.split(b"\r\n\r\n", 1)[1])
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="Load test the EspTemp gateway with fake boards and clients")
+    parser.add_argument("gateway", help="path to the esptemp-gateway binary")
+    parser.add_argument("--boards", type=int, default=50)
+    parser.add_argument("--clients", type=int, default=10)
+    parser.add_argument("--duration", type=float, default=10, help="seconds of measurement (default %(default)s)")
+    parser.add_argument("--probes", type=int, default=20, help="clients that check and time every message")
+    parser.add_argument("--board-interval", type=float, default=1.0, help="seconds between readings per board")
+    parser.add_argument("--error-rate", type=float, default=0.01, help="fraction of readings that are sensor errors")
+    parser.add_argument("--alert-rate", type=float, default=0.01, help="fraction of readings followed by an alert")
+    parser.add_argument("--board-port", type=int, default=20000, help="first port for fake boards")
+    parser.add_argument("--port", type=int, default=18080, help="gateway listen port")
+    args = parser.parse_args()
+
+    boards = [FakeBoard(args.board_interval, args.error_rate, args.alert_rate) for _ in range(args.boards)]
+    servers = []
+    for i, b in enumerate(boards):
+        servers.append(await asyncio.start_server(b.handle, "127.0.0.1", args.board_port + i))
+
+    with tempfile.NamedTemporaryFile("w", suffix=".txt", delete=False) as f:
+        for i in range(args.boards):
+            f.write("board%d=127.0.0.1:%d\n" % (i, args.board_port + i))
+        boards_file = f.name
+
+    gateway = subprocess.Popen([args.gateway, "-f", boards_file, "-p", str(args.port),
+                                "-c", str(args.clients + 16)], stdout=subprocess.DEVNULL)
+    try:
+        # Wait until the gateway has every board
+        start = time.monotonic()
+        while True:
+            await asyncio.sleep(0.5)
+            try:
+                if (await get_stats(args.port))["boardsOnline"] == args.boards:
+                    break
+            except (ConnectionError, ValueError, IndexError):
+                pass
+            if time.monotonic() - start > 30:
+                sys.exit("gateway did not connect to every board within 30 s")
+        connect_time = time.monotonic() - start
+
+        window_start = time.monotonic()
+        deadline = window_start + args.duration
+        dashboards = [Dashboard(args.boards, i < args.probes) for i in range(args.clients)]
+        await asyncio.gather(*(d.run(args.port, deadline) for d in dashboards))
+        stats = await get_stats(args.port)
+
+        # Reboot every other board and wait for the gateway to come back to it
+        kicked = boards[::2]
+        before = [b.accepted for b in kicked]
+        for b in kicked:
+            b.kick()
+        start = time.monotonic()
+        reconnected = False
+        while time.monotonic() - start < 30:
+            await asyncio.sleep(0.5)
+            if all(b.accepted > n and b.writers for b, n in zip(kicked, before)):
+                try:
+                    reconnected = (await get_stats(args.port))["boardsOnline"] == args.boards
+                except (ConnectionError, ValueError, IndexError):
+                    pass
+            if reconnected:
+                break
+        reconnect_time = time.monotonic() - start
+        # Let a duplicate connection show up if the gateway was going to open one
+        await asyncio.sleep(2 * args.board_interval)
+    finally:
+        gateway.terminate()
+        gateway.wait()
+        os.unlink(boards_file)
+        for s in servers:
+            s.close()
+
+    latencies = [l for d in dashboards for l in d.latencies]
+    alert_latencies = [l for d in dashboards for l in d.alert_latencies]
+    probes = [d for d in dashboards if d.probe]
+    messages = sum(d.messages for d in dashboards)
+    snapshots = sum(1 for d in dashboards if d.snapshot_ok)
+    bad = sum(d.bad_entries for d in dashboards)
+    dropped = sum(1 for d in dashboards if d.closed)
+    open_now = [len(b.writers) for b in boards]
+
+    print("boards %d, clients %d, %.0f s" % (args.boards, args.clients, args.duration))
+    print("  all boards online after   %.1f s" % connect_time)
+    print("  board readings sent       %d" % sum(b.sent for b in boards))
+    print("  connections per board     max %d at once, %d now (min %d), %d accepted in total" %
+          (max(b.max_open for b in boards), max(open_now), min(open_now), sum(b.accepted for b in boards)))
+    print("  %d boards reconnected after %.1f s" % (len(kicked), reconnect_time))
+    print("  messages per client/s     %.1f" % (messages / max(1, args.clients) / args.duration))
+    print("  bytes per client/s        %.0f" % (sum(d.bytes for d in dashboards) / max(1, args.clients) / args.duration))
+    print("  latency p50 / p99 / max   %d / %d / %d ms (10 ms resolution)" %
+          (percentile(latencies, 0.5), percentile(latencies, 0.99), max(latencies or [0])))
+    # Probes connect at the start of the window; allow a second either side
+    expected_alerts = sum(1 for b in boards for t in b.alerts if window_start + 1 <= t <= deadline - 1)
+    print("  alerts sent / per probe   %d / %d..%d, latency p99 %d ms" %
+          (expected_alerts, min(d.alerts for d in probes or dashboards),
+           max(d.alerts for d in probes or dashboards), percentile(alert_latencies, 0.99)))
+    print("  gateway stats             %s" % json.dumps(stats))
+
+    failures = []
+    if snapshots != args.clients:
+        failures.append("%d of %d clients got a full snapshot" % (snapshots, args.clients))
+    if bad:
+        failures.append("%d invalid board entries" % bad)
+    bad_alerts = sum(d.bad_alerts for d in dashboards)
+    if bad_alerts:
+        failures.append("%d invalid alerts" % bad_alerts)
+    missed = sum(1 for d in probes if d.alerts < expected_alerts)
+    if missed:
+        failures.append("%d probes missed some of the %d alerts" % (missed, expected_alerts))
+    if dropped or stats["clientsDropped"]:
+        failures.append("%d clients dropped" % max(dropped, stats["clientsDropped"]))
+    if not reconnected:
+        failures.append("gateway did not reconnect every board within 30 s")
+    doubled = sum(1 for b in boards if b.max_open > 1)
+    if doubled:
+        failures.append("%d boards had more than one gateway connection at once" % doubled)
+    if open_now.count(1) != args.boards:
+        failures.append("%d boards do not have exactly one gateway connection" % (args.boards - open_now.count(1)))
+    for f in failures:
+        print("FAIL:", f)
+    print("PASS" if not failures else "FAIL")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(asyncio.run(main()))
@@ -0,0 +1,54 @@
+#ifndef ALERT_RULES_H
+#define ALERT_RULES_H
+
+#include <Arduino.h>
+
+#define ALERT_MAX_RULES 8
+#define ALERT_CONFIRM_SAMPLES 3  // Condition must hold this many samples before raising
+#define ALERT_SMOOTH_SHIFT 3     // Rules see a running average with weight 1/8 per sample
+#define ALERT_RATE_WINDOW 60000  // ms, rate of change is measured over this window
+#define ALERT_RATE_STEPS 6       // Checkpoints kept inside the window
+#define ALERT_RULES_FILE "/alerts.bin"
+#define ALERT_TEMP_MIN -55.0f    // DS18B20 range: high/low thresholds outside it never fire
+#define ALERT_TEMP_MAX 125.0f
+#define ALERT_STALE_MAX 86400.0f // s, longest stale timeout a rule may set
+
+enum AlertRuleType : uint8_t
+{
+  RULE_NONE = 0,
+  RULE_HIGH,  // Above threshold °C, clears below threshold - hysteresis
+  RULE_LOW,   // Below threshold °C, clears above threshold + hysteresis
+  RULE_RATE,  // °C per minute; positive threshold = rising, negative = falling
+  RULE_STALE  // No valid reading for threshold seconds
+};
+
+struct AlertRule
+{
+  AlertRuleType type;
+  uint8_t priority; // Higher is more urgent, sent first
+  float threshold;
+  float hysteresis;
+};
+
+struct AlertEvent
+{
+  uint8_t slot;
+  AlertRuleType type;
+  uint8_t priority;
+  bool raised; // false = cleared
+  float value;
+  float threshold;
+};
+
+typedef void (*AlertCallback)(const AlertEvent &event);
+
+void alertsBegin(AlertCallback callback);
+void alertsEvaluate(bool valid, float temperature, uint32_t now);
+bool alertsSetRule(uint8_t slot, const AlertRule &rule);
+bool alertsClearRule(uint8_t slot);
+String alertsJson();
+
+const char *alertTypeName(AlertRuleType type);
+AlertRuleType alertTypeFromName(const String &name);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef WS_FANOUT_H
+#define WS_FANOUT_H
+
+#include <ESPAsyncWebServer.h>
+
+// Fan-out limits
+#ifndef WS_FANOUT_MAX_CLIENTS
+#define WS_FANOUT_MAX_CLIENTS 8       // Further connections are refused
+#endif
+#define WS_FANOUT_STALL_TIMEOUT 5000  // ms a client's queue may stay full before it is evicted
+#define WS_FANOUT_ALERT_SLOTS 4       // Alerts kept for clients that are behind
+#define WS_FANOUT_ALERT_LEN 160       // Max length of one alert message
+
+// Per-client queue depth is capped by WS_MAX_QUEUED_MESSAGES (platformio.ini):
+// once a client's queue is full it is skipped and simply gets the newest frame
+// when it catches up. Alerts are never skipped that way: they wait in a small
+// ring and are queued ahead of the next temperature frame. Alerts longer than
+// WS_FANOUT_ALERT_LEN are dropped and counted as alertsRejected in the stats.
+
+void fanoutBegin(AsyncWebSocket *socket);
+bool fanoutOnConnect(AsyncWebSocketClient *client);
+void fanoutOnDisconnect(AsyncWebSocketClient *client);
+void fanoutBroadcast(const char *data, size_t len);
+bool fanoutPushAlert(const char *data, size_t len);
+void fanoutCountRejectedAlert();
+String fanoutStatsJson();
+
+#endif
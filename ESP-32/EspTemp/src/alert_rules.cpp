@@ -0,0 +1,373 @@
+#include "alert_rules.h"
+#include <SPIFFS.h>
+#include <math.h>
+
+#define ALERT_FILE_MAGIC 0x31524C41 // "ALR1"
+
+struct RuleState
+{
+  bool active;
+  bool reset;         // Rule was edited, clear any raised alarm on the next sample
+  uint8_t pending;    // Consecutive samples asking for a transition
+  AlertRuleType activeType;
+};
+
+static AlertRule rules[ALERT_MAX_RULES];
+static RuleState states[ALERT_MAX_RULES];
+static AlertCallback onAlert = nullptr;
+
+// Rules are edited from the web server task, evaluated from loop()
+static portMUX_TYPE rulesMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Rate of change: one checkpoint every ALERT_RATE_WINDOW / ALERT_RATE_STEPS,
+// so each sample costs O(1) no matter how long the window is
+static float rateTemp[ALERT_RATE_STEPS + 1];
+static uint32_t rateTime[ALERT_RATE_STEPS + 1];
+static uint8_t rateHead = 0;
+static uint8_t rateCount = 0;
+static uint32_t lastValid = 0;
+static float lastRate = 0;
+static bool rateKnown = false;
+
+// Input filter: a median of the last three readings drops single-sample
+// glitches (a DS18B20 reads 85.0 before its first conversion), then a running
+// average smooths out noise and the 0.5 °C steps of 9-bit readings, which
+// would otherwise eat most of a 0.5 °C hysteresis
+static float recent[3];
+static uint8_t recentCount = 0;
+static float smoothed = 0;
+
+static const AlertRule defaultRules[] = {
+    {RULE_HIGH, 2, 35.0f, 0.5f},
+    {RULE_LOW, 2, 10.0f, 0.5f},
+    {RULE_RATE, 1, 2.0f, 0.5f},
+    {RULE_STALE, 3, 10.0f, 2.0f},
+};
+
+// Thresholds come from toFloat(), which also parses "nan" and "inf"
+static bool validRule(const AlertRule &rule)
+{
+  const float span = ALERT_TEMP_MAX - ALERT_TEMP_MIN;
+  if (!isfinite(rule.threshold) || !isfinite(rule.hysteresis) || rule.hysteresis < 0 || rule.hysteresis > span)
+    return false;
+
+  switch (rule.type)
+  {
+  case RULE_HIGH:
+  case RULE_LOW:
+    return rule.threshold >= ALERT_TEMP_MIN && rule.threshold <= ALERT_TEMP_MAX;
+  case RULE_RATE:
+    return rule.threshold != 0 && fabsf(rule.threshold) <= span; // °C/min
+  case RULE_STALE:
+    return rule.threshold > 0 && rule.threshold <= ALERT_STALE_MAX;
+  default:
+    return false;
+  }
+}
+
+static void saveRules()
+{
+  AlertRule copy[ALERT_MAX_RULES];
+  portENTER_CRITICAL(&rulesMux);
+  memcpy(copy, rules, sizeof(copy));
+  portEXIT_CRITICAL(&rulesMux);
+
+  File f = SPIFFS.open(ALERT_RULES_FILE, "w");
+  if (!f)
+  {
+    Serial.println("ERROR: cannot save alert rules");
+    return;
+  }
+  uint32_t magic = ALERT_FILE_MAGIC;
+  f.write((const uint8_t *)&magic, sizeof(magic));
+  f.write((const uint8_t *)copy, sizeof(copy));
+  f.close();
+}
+
+static bool loadRules()
+{
+  File f = SPIFFS.open(ALERT_RULES_FILE, "r");
+  if (!f)
+    return false;
+
+  uint32_t magic = 0;
+  bool ok = f.read((uint8_t *)&magic, sizeof(magic)) == sizeof(magic) && magic == ALERT_FILE_MAGIC &&
+            f.read((uint8_t *)rules, sizeof(rules)) == sizeof(rules);
+  f.close();
+  if (!ok)
+    return false;
+
+  // Written by an older build, or damaged: drop what it could not have accepted
+  for (uint8_t i = 0; i < ALERT_MAX_RULES; i++)
+  {
+    if (rules[i].type != RULE_NONE && !validRule(rules[i]))
+    {
+      Serial.printf("Alert rules: slot %u invalid, cleared\n", i);
+      rules[i].type = RULE_NONE;
+    }
+  }
+  return true;
+}
+
+void alertsBegin(AlertCallback callback)
+{
+  onAlert = callback;
+  memset(states, 0, sizeof(states));
+  recentCount = 0;
+  lastValid = millis(); // Stale timer starts at boot
+
+  if (!loadRules())
+  {
+    memset(rules, 0, sizeof(rules));
+    memcpy(rules, defaultRules, sizeof(defaultRules));
+    saveRules();
+    Serial.println("Alert rules: defaults");
+  }
+  else
+  {
+    Serial.println("Alert rules: loaded from flash");
+  }
+}
+
+static float filterReading(float temperature)
+{
+  recent[0] = recent[1];
+  recent[1] = recent[2];
+  recent[2] = temperature;
+  if (recentCount < 3)
+    recentCount++;
+
+  float m = temperature;
+  if (recentCount == 3)
+  {
+    float lo = min(recent[0], recent[1]), hi = max(recent[0], recent[1]);
+    m = recent[2] < lo ? lo : recent[2] > hi ? hi : recent[2];
+  }
+
+  if (recentCount == 1)
+    smoothed = m; // First reading since boot
+  else
+    smoothed += (m - smoothed) / (1 << ALERT_SMOOTH_SHIFT);
+  return smoothed;
+}
+
+static void updateRate(bool valid, float temperature, uint32_t now)
+{
+  if (!valid)
+  {
+    // A gap would fake a slope, start the window over
+    rateCount = 0;
+    rateKnown = false;
+    return;
+  }
+
+  uint8_t newest = (rateHead + ALERT_RATE_STEPS) % (ALERT_RATE_STEPS + 1);
+  if (rateCount == 0 || now - rateTime[newest] >= ALERT_RATE_WINDOW / ALERT_RATE_STEPS)
+  {
+    rateTemp[rateHead] = temperature;
+    rateTime[rateHead] = now;
+    rateHead = (rateHead + 1) % (ALERT_RATE_STEPS + 1);
+    if (rateCount < ALERT_RATE_STEPS + 1)
+      rateCount++;
+  }
+
+  uint8_t oldest = (rateHead + ALERT_RATE_STEPS + 1 - rateCount) % (ALERT_RATE_STEPS + 1);
+  uint32_t span = now - rateTime[oldest];
+
+  // Need at least half a window before the slope means anything
+  rateKnown = span >= ALERT_RATE_WINDOW / 2;
+  if (rateKnown)
+    lastRate = (temperature - rateTemp[oldest]) * 60000.0f / span;
+}
+
+// True when the rule's condition holds, with hysteresis towards the current state
+static bool ruleCondition(const AlertRule &rule, bool active, float value)
+{
+  float th = rule.threshold;
+  float hyst = rule.hysteresis;
+
+  switch (rule.type)
+  {
+  case RULE_HIGH:
+  case RULE_STALE:
+    return active ? value > th - hyst : value > th;
+  case RULE_LOW:
+    return active ? value < th + hyst : value < th;
+  case RULE_RATE:
+    if (th >= 0)
+      return active ? value > th - hyst : value > th;
+    return active ? value < th + hyst : value < th;
+  default:
+    return false;
+  }
+}
+
+void alertsEvaluate(bool valid, float temperature, uint32_t now)
+{
+  if (valid)
+  {
+    lastValid = now;
+    temperature = filterReading(temperature);
+  }
+  updateRate(valid, temperature, now);
+
+  AlertEvent events[ALERT_MAX_RULES];
+  uint8_t count = 0;
+
+  portENTER_CRITICAL(&rulesMux);
+  for (uint8_t i = 0; i < ALERT_MAX_RULES; i++)
+  {
+    const AlertRule &rule = rules[i];
+    RuleState &state = states[i];
+
+    if (state.reset)
+    {
+      state.reset = false;
+      state.pending = 0;
+      if (state.active)
+      {
+        state.active = false;
+        events[count++] = {i, state.activeType, rule.priority, false, temperature, rule.threshold};
+      }
+    }
+
+    if (rule.type == RULE_NONE)
+      continue;
+
+    // Without a value the rule keeps its current state
+    float value;
+    if (rule.type == RULE_STALE)
+      value = (now - lastValid) / 1000.0f;
+    else if (rule.type == RULE_RATE && valid && rateKnown)
+      value = lastRate;
+    else if ((rule.type == RULE_HIGH || rule.type == RULE_LOW) && valid)
+      value = temperature;
+    else
+    {
+      state.pending = 0;
+      continue;
+    }
+
+    if (ruleCondition(rule, state.active, value) == state.active)
+    {
+      state.pending = 0;
+      continue;
+    }
+    if (++state.pending < ALERT_CONFIRM_SAMPLES)
+      continue;
+
+    state.pending = 0;
+    state.active = !state.active;
+    state.activeType = rule.type;
+    events[count++] = {i, rule.type, rule.priority, state.active, value, rule.threshold};
+  }
+  portEXIT_CRITICAL(&rulesMux);
+
+  // Most urgent first
+  for (uint8_t i = 1; i < count; i++)
+  {
+    AlertEvent e = events[i];
+    int j = i - 1;
+    while (j >= 0 && events[j].priority < e.priority)
+    {
+      events[j + 1] = events[j];
+      j--;
+    }
+    events[j + 1] = e;
+  }
+
+  for (uint8_t i = 0; i < count && onAlert; i++)
+    onAlert(events[i]);
+}
+
+bool alertsSetRule(uint8_t slot, const AlertRule &rule)
+{
+  if (slot >= ALERT_MAX_RULES || !validRule(rule))
+    return false;
+
+  portENTER_CRITICAL(&rulesMux);
+  rules[slot] = rule;
+  states[slot].reset = true;
+  portEXIT_CRITICAL(&rulesMux);
+
+  saveRules();
+  return true;
+}
+
+bool alertsClearRule(uint8_t slot)
+{
+  if (slot >= ALERT_MAX_RULES)
+    return false;
+
+  portENTER_CRITICAL(&rulesMux);
+  rules[slot].type = RULE_NONE;
+  states[slot].reset = true;
+  portEXIT_CRITICAL(&rulesMux);
+
+  saveRules();
+  return true;
+}
+
+String alertsJson()
+{
+  AlertRule rulesCopy[ALERT_MAX_RULES];
+  RuleState statesCopy[ALERT_MAX_RULES];
+  portENTER_CRITICAL(&rulesMux);
+  memcpy(rulesCopy, rules, sizeof(rules));
+  memcpy(statesCopy, states, sizeof(states));
+  portEXIT_CRITICAL(&rulesMux);
+
+  String json = "{\"rules\":[";
+  bool first = true;
+  for (uint8_t i = 0; i < ALERT_MAX_RULES; i++)
+  {
+    const AlertRule &rule = rulesCopy[i];
+    if (rule.type == RULE_NONE)
+      continue;
+    if (!first)
+      json += ',';
+    first = false;
+
+    json += "{\"slot\":" + String(i);
+    json += ",\"type\":\"" + String(alertTypeName(rule.type)) + "\"";
+    json += ",\"priority\":" + String(rule.priority);
+    json += ",\"threshold\":" + String(rule.threshold, 2);
+    json += ",\"hysteresis\":" + String(rule.hysteresis, 2);
+    json += ",\"active\":" + String(statesCopy[i].active ? "true" : "false");
+    json += "}";
+  }
+  json += "],\"rate\":";
+  json += rateKnown ? String(lastRate, 2) : String("null");
+  json += "}";
+  return json;
+}
+
+const char *alertTypeName(AlertRuleType type)
+{
+  switch (type)
+  {
+  case RULE_HIGH:
+    return "high";
+  case RULE_LOW:
+    return "low";
+  case RULE_RATE:
+    return "rate";
+  case RULE_STALE:
+    return "stale";
+  default:
+    return "none";
+  }
+}
+
+AlertRuleType alertTypeFromName(const String &name)
+{
+  if (name == "high")
+    return RULE_HIGH;
+  if (name == "low")
+    return RULE_LOW;
+  if (name == "rate")
+    return RULE_RATE;
+  if (name == "stale")
+    return RULE_STALE;
+  return RULE_NONE;
+}
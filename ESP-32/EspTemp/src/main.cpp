@@ -4,6 +4,8 @@
 #include <ESPAsyncWebServer.h>
 #include <AsyncTCP.h>
 #include <SPIFFS.h>
+#include "ws_fanout.h"
+#include "alert_rules.h"
 
 // WiFi credentials
 const char *ssid = "Ravi4G";
@@ -52,10 +54,37 @@ String getTemperature()
   return String(tempC, 1); // Reduced precision for faster processing
 }
 
+// Longest onAlert() message: widest names and numbers, values as large as a
+// stale time in seconds can get from millis()
+#define ALERT_MESSAGE_LONGEST "{\"alert\":\"stale\",\"slot\":255,\"state\":\"cleared\",\"priority\":255," \
+                              "\"value\":-4294967.30,\"threshold\":-4294967.30}"
+static_assert(sizeof(ALERT_MESSAGE_LONGEST) - 1 <= WS_FANOUT_ALERT_LEN, "alert messages would not fit the fan-out ring");
+
+// Alert raised or cleared: pushed to every client ahead of temperature frames
+void onAlert(const AlertEvent &event)
+{
+  char message[sizeof(ALERT_MESSAGE_LONGEST)];
+  int len = snprintf(message, sizeof(message),
+                     "{\"alert\":\"%s\",\"slot\":%u,\"state\":\"%s\",\"priority\":%u,\"value\":%.2f,\"threshold\":%.2f}",
+                     alertTypeName(event.type), event.slot, event.raised ? "raised" : "cleared",
+                     event.priority, event.value, event.threshold);
+  if (len < 0 || len >= (int)sizeof(message))
+  {
+    // Truncated JSON would break every client's parser, drop it instead
+    Serial.printf("ERROR: alert for slot %u does not fit (%d bytes), dropped\n", event.slot, len);
+    fanoutCountRejectedAlert();
+    return;
+  }
+
+  fanoutPushAlert(message, len);
+  Serial.println("Alert: " + String(message));
+}
+
 // Send temperature via WebSocket (JSON format for better handling)
 void notifyClients()
 {
   String temp = getTemperature();
+  alertsEvaluate(!sensorError, lastTemperature, millis());
   String message;
 
   if (sensorError)
@@ -67,7 +96,7 @@ void notifyClients()
     message = "{\"temperature\":" + temp + ",\"status\":\"ok\"}";
   }
 
-  ws.textAll(message);
+  fanoutBroadcast(message.c_str(), message.length());
   Serial.println("Sent: " + message);
 }
 
@@ -80,12 +109,18 @@ void onWebSocketEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
   case WS_EVT_CONNECT:
     Serial.printf("WebSocket client #%u connected from %s\n",
                   client->id(), client->remoteIP().toString().c_str());
+    if (!fanoutOnConnect(client))
+    {
+      Serial.println("Client limit reached, connection refused");
+      break;
+    }
     // Send current temperature immediately to new client
     client->text(sensorError ? "{\"temperature\":\"Error\",\"status\":\"error\"}" : "{\"temperature\":" + String(lastTemperature, 2) + ",\"status\":\"ok\"}");
     break;
 
   case WS_EVT_DISCONNECT:
     Serial.printf("WebSocket client #%u disconnected\n", client->id());
+    fanoutOnDisconnect(client);
     break;
 
   case WS_EVT_DATA:
@@ -127,6 +162,9 @@ void setup()
   }
   Serial.println("SPIFFS mounted successfully");
 
+  // Alert rules live in SPIFFS
+  alertsBegin(onAlert);
+
   // Connect to WiFi
   WiFi.mode(WIFI_STA);
   WiFi.begin(ssid, password);
@@ -154,6 +192,7 @@ void setup()
   Serial.println(" dBm");
 
   // Setup WebSocket
+  fanoutBegin(&ws);
   ws.onEvent(onWebSocketEvent);
   server.addHandler(&ws);
 
@@ -175,6 +214,52 @@ void setup()
       request->send(200, "application/json", json);
     } });
 
+  // WebSocket fan-out stats (clients, skipped frames, evictions, heap, broadcast time)
+  server.on("/stats", HTTP_GET, [](AsyncWebServerRequest *request)
+            { request->send(200, "application/json", fanoutStatsJson()); });
+
+  // Alert rules and their current state
+  server.on("/alerts", HTTP_GET, [](AsyncWebServerRequest *request)
+            { request->send(200, "application/json", alertsJson()); });
+
+  // Add or replace a rule: /alerts/set?slot=0&type=high&threshold=35&hysteresis=0.5&priority=2
+  server.on("/alerts/set", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    if (!request->hasParam("slot") || !request->hasParam("type") || !request->hasParam("threshold")) {
+      request->send(400, "application/json", "{\"error\":\"slot, type and threshold required\"}");
+      return;
+    }
+
+    // Range-check before narrowing to uint8_t, or slot=256 would land in slot 0
+    long slot = request->getParam("slot")->value().toInt();
+    long priority = request->hasParam("priority") ? request->getParam("priority")->value().toInt() : 1;
+    if (slot < 0 || slot >= ALERT_MAX_RULES || priority < 0 || priority > 255) {
+      request->send(400, "application/json", "{\"error\":\"slot or priority out of range\"}");
+      return;
+    }
+
+    AlertRule rule;
+    rule.type = alertTypeFromName(request->getParam("type")->value());
+    rule.threshold = request->getParam("threshold")->value().toFloat();
+    rule.hysteresis = request->hasParam("hysteresis") ? request->getParam("hysteresis")->value().toFloat() : 0;
+    rule.priority = priority;
+
+    // Also rejects nan/inf, which toFloat() accepts, and thresholds the sensor can never reach
+    if (!alertsSetRule(slot, rule)) {
+      request->send(400, "application/json", "{\"error\":\"invalid rule or threshold out of range\"}");
+      return;
+    }
+    request->send(200, "application/json", alertsJson()); });
+
+  server.on("/alerts/delete", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    long slot = request->hasParam("slot") ? request->getParam("slot")->value().toInt() : -1;
+    if (slot < 0 || slot >= ALERT_MAX_RULES || !alertsClearRule(slot)) {
+      request->send(400, "application/json", "{\"error\":\"invalid slot\"}");
+      return;
+    }
+    request->send(200, "application/json", alertsJson()); });
+
   // Handle 404
   server.onNotFound([](AsyncWebServerRequest *request)
                     { request->send(404, "text/plain", "Not found"); });
@@ -0,0 +1,277 @@
+#include "ws_fanout.h"
+
+struct FanoutClient
+{
+  uint32_t id;           // 0 = free slot
+  uint32_t lastProgress; // millis() when the client last had room in its queue
+  uint32_t sent;
+  uint32_t skipped;
+  uint32_t alertSeq; // Last alert queued to this client
+  bool evicted;      // Aborted, skipped until the disconnect frees the slot
+};
+
+struct FanoutStats
+{
+  uint32_t broadcasts;
+  uint32_t framesSent;
+  uint32_t framesSkipped;
+  uint32_t evicted;
+  uint32_t rejected;
+  uint32_t alertsSent;
+  uint32_t alertsDropped;  // Lost by clients that were behind
+  uint32_t alertsRejected; // Never stored: too long for a slot
+  uint32_t lastBroadcastMicros;
+  uint32_t maxBroadcastMicros;
+};
+
+static AsyncWebSocket *ws = nullptr;
+static FanoutClient clients[WS_FANOUT_MAX_CLIENTS];
+static FanoutStats stats;
+
+struct FanoutAlert
+{
+  uint16_t len;
+  char data[WS_FANOUT_ALERT_LEN];
+};
+
+// Alerts are pushed and delivered from loop() only
+static FanoutAlert alerts[WS_FANOUT_ALERT_SLOTS];
+static uint32_t alertSeq = 0; // Sequence number of the newest alert
+
+// Connect/disconnect arrive on the AsyncTCP task, broadcasts run in loop().
+// loop() works on a copy of the slots and writes each one back only if it
+// still belongs to the same client.
+static portMUX_TYPE clientsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void snapshotClients(FanoutClient *copy)
+{
+  portENTER_CRITICAL(&clientsMux);
+  memcpy(copy, clients, sizeof(clients));
+  portEXIT_CRITICAL(&clientsMux);
+}
+
+static void commitClients(const FanoutClient *copy)
+{
+  portENTER_CRITICAL(&clientsMux);
+  for (int i = 0; i < WS_FANOUT_MAX_CLIENTS; i++)
+  {
+    if (copy[i].id && clients[i].id == copy[i].id)
+      clients[i] = copy[i];
+  }
+  portEXIT_CRITICAL(&clientsMux);
+}
+
+void fanoutBegin(AsyncWebSocket *socket)
+{
+  ws = socket;
+  memset(clients, 0, sizeof(clients));
+  memset(&stats, 0, sizeof(stats));
+}
+
+// Returns false (and closes the client) when all slots are taken
+bool fanoutOnConnect(AsyncWebSocketClient *client)
+{
+  bool added = false;
+  portENTER_CRITICAL(&clientsMux);
+  for (FanoutClient &c : clients)
+  {
+    if (c.id == 0)
+    {
+      c = {client->id(), millis(), 0, 0, alertSeq, false}; // Past alerts are in GET /alerts
+      added = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&clientsMux);
+
+  if (!added)
+  {
+    stats.rejected++;
+    client->close(1013, "Too many clients"); // 1013 = try again later
+  }
+  return added;
+}
+
+void fanoutOnDisconnect(AsyncWebSocketClient *client)
+{
+  portENTER_CRITICAL(&clientsMux);
+  for (FanoutClient &c : clients)
+  {
+    if (c.id == client->id())
+      c.id = 0;
+  }
+  portEXIT_CRITICAL(&clientsMux);
+}
+
+// Queues the alerts this client has not seen yet, as far as its queue allows.
+// Returns false while some are still pending.
+static bool deliverAlerts(AsyncWebSocketClient *client, FanoutClient &c)
+{
+  if (alertSeq - c.alertSeq > WS_FANOUT_ALERT_SLOTS)
+  {
+    // Ring wrapped while the client was stalled
+    stats.alertsDropped += alertSeq - c.alertSeq - WS_FANOUT_ALERT_SLOTS;
+    c.alertSeq = alertSeq - WS_FANOUT_ALERT_SLOTS;
+  }
+
+  while (c.alertSeq != alertSeq)
+  {
+    if (client->queueIsFull())
+      return false;
+    const FanoutAlert &a = alerts[(c.alertSeq + 1) % WS_FANOUT_ALERT_SLOTS];
+    client->text(a.data, a.len);
+    c.alertSeq++;
+    c.lastProgress = millis();
+    stats.alertsSent++;
+  }
+  return true;
+}
+
+static AsyncWebSocketClient *liveClient(const FanoutClient &c)
+{
+  if (c.id == 0 || c.evicted)
+    return nullptr;
+  AsyncWebSocketClient *client = ws->client(c.id);
+  if (!client || client->status() != WS_CONNECTED)
+    return nullptr;
+  return client;
+}
+
+// Counts an alert the caller could not build; shows up in the stats
+void fanoutCountRejectedAlert()
+{
+  stats.alertsRejected++;
+}
+
+// Stores the alert and queues it right away on every client with room; the
+// rest get it ahead of their next temperature frame. Returns false if the
+// alert was dropped.
+bool fanoutPushAlert(const char *data, size_t len)
+{
+  if (!ws)
+    return false; // Not started: setup() bailed out before the server came up
+  if (len > WS_FANOUT_ALERT_LEN)
+  {
+    Serial.printf("ERROR: alert of %u bytes exceeds WS_FANOUT_ALERT_LEN, dropped\n", (unsigned)len);
+    stats.alertsRejected++;
+    return false;
+  }
+
+  alertSeq++;
+  FanoutAlert &a = alerts[alertSeq % WS_FANOUT_ALERT_SLOTS];
+  memcpy(a.data, data, len);
+  a.len = len;
+
+  FanoutClient copy[WS_FANOUT_MAX_CLIENTS];
+  snapshotClients(copy);
+  for (FanoutClient &c : copy)
+  {
+    AsyncWebSocketClient *client = liveClient(c);
+    if (client)
+      deliverAlerts(client, c);
+  }
+  commitClients(copy);
+  return true;
+}
+
+// Serializes the frame once into a shared, reference-counted buffer and queues
+// that same buffer on every client that has room. Lagging clients skip the
+// frame; ones that stay stalled past the deadline are dropped.
+void fanoutBroadcast(const char *data, size_t len)
+{
+  if (!ws)
+    return;
+
+  uint32_t start = micros();
+  uint32_t now = millis();
+
+  FanoutClient copy[WS_FANOUT_MAX_CLIENTS];
+  snapshotClients(copy);
+
+  AsyncWebSocketMessageBuffer *buffer = nullptr;
+
+  for (FanoutClient &c : copy)
+  {
+    AsyncWebSocketClient *client = liveClient(c);
+    if (!client)
+      continue;
+
+    bool alertsDone = deliverAlerts(client, c);
+    if (alertsDone && !client->queueIsFull())
+    {
+      if (!buffer)
+      {
+        buffer = ws->makeBuffer(len);
+        if (!buffer)
+          break; // Out of memory: drop the frame, keep the alerts already queued
+        memcpy(buffer->get(), data, len);
+      }
+      client->text(buffer);
+      c.lastProgress = now;
+      c.sent++;
+      stats.framesSent++;
+      continue;
+    }
+
+    // Queue still full: this frame is superseded by the next one anyway
+    c.skipped++;
+    stats.framesSkipped++;
+    if (now - c.lastProgress > WS_FANOUT_STALL_TIMEOUT)
+    {
+      // The client reports connected until AsyncTCP delivers the disconnect
+      Serial.printf("WebSocket client #%u stalled, evicting\n", c.id);
+      c.evicted = true;
+      stats.evicted++;
+      client->client()->close(true); // Abort, a close frame would never get through
+    }
+  }
+  commitClients(copy);
+
+  // Frees the buffer once no client queue references it (same as textAll)
+  ws->_cleanBuffers();
+
+  stats.broadcasts++;
+  stats.lastBroadcastMicros = micros() - start;
+  if (stats.lastBroadcastMicros > stats.maxBroadcastMicros)
+    stats.maxBroadcastMicros = stats.lastBroadcastMicros;
+}
+
+String fanoutStatsJson()
+{
+  FanoutClient copy[WS_FANOUT_MAX_CLIENTS];
+  snapshotClients(copy);
+
+  uint32_t now = millis();
+  uint8_t active = 0;
+  String list;
+  for (const FanoutClient &c : copy)
+  {
+    if (!c.id)
+      continue;
+    if (active++)
+      list += ',';
+    list += "{\"id\":" + String(c.id);
+    list += ",\"sent\":" + String(c.sent);
+    list += ",\"skipped\":" + String(c.skipped);
+    list += ",\"sinceProgressMs\":" + String(now - c.lastProgress);
+    list += "}";
+  }
+
+  String json = "{\"clients\":" + String(active);
+  json += ",\"maxClients\":" + String(WS_FANOUT_MAX_CLIENTS);
+  json += ",\"broadcasts\":" + String(stats.broadcasts);
+  json += ",\"framesSent\":" + String(stats.framesSent);
+  json += ",\"framesSkipped\":" + String(stats.framesSkipped);
+  json += ",\"evicted\":" + String(stats.evicted);
+  json += ",\"rejected\":" + String(stats.rejected);
+  json += ",\"alertsSent\":" + String(stats.alertsSent);
+  json += ",\"alertsDropped\":" + String(stats.alertsDropped);
+  json += ",\"alertsRejected\":" + String(stats.alertsRejected);
+  json += ",\"broadcastUs\":" + String(stats.lastBroadcastMicros);
+  json += ",\"maxBroadcastUs\":" + String(stats.maxBroadcastMicros);
+  json += ",\"freeHeap\":" + String(ESP.getFreeHeap());
+  json += ",\"minFreeHeap\":" + String(ESP.getMinFreeHeap());
+  json += ",\"clientList\":[" + list + "]";
+  json += "}";
+  return json;
+}
@@ -0,0 +1,87 @@
+// Host stand-in for the parts of the ESP32 Arduino core the firmware modules use.
+// Time is simulated: tests move fakeMicros forward, delay() advances it.
+#ifndef STUB_ARDUINO_H
+#define STUB_ARDUINO_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using std::max;
+using std::min;
+
+inline uint32_t fakeMicros = 0;
+inline uint32_t micros() { return fakeMicros; }
+inline uint32_t millis() { return fakeMicros / 1000; } // 32-bit on the ESP32 too
+inline void delay(unsigned long ms) { fakeMicros += ms * 1000; }
+inline void yield() {}
+
+// Single-threaded on the host, critical sections have nothing to guard
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+class String
+{
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  String(double v, unsigned decimals = 2)
+  {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    s_ = buf;
+  }
+
+  unsigned length() const { return s_.length(); }
+  const char *c_str() const { return s_.c_str(); }
+  char operator[](unsigned i) const { return i < s_.length() ? s_[i] : 0; }
+
+  String &operator+=(const String &o) { s_ += o.s_; return *this; }
+  String &operator+=(const char *o) { s_ += o; return *this; }
+  String &operator+=(char c) { s_ += c; return *this; }
+  friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+  friend String operator+(const String &a, const char *b) { return String(a.s_ + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.s_); }
+  bool operator==(const char *o) const { return s_ == o; }
+
+  int indexOf(const char *str, unsigned from = 0) const
+  {
+    size_t i = s_.find(str, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  long toInt() const { return atol(s_.c_str()); }
+  float toFloat() const { return atof(s_.c_str()); }
+
+private:
+  std::string s_;
+};
+
+struct SerialStub
+{
+  template <typename... Args> void printf(const char *, Args...) {}
+  template <typename T> void print(const T &) {}
+  template <typename T> void println(const T &) {}
+  void println() {}
+};
+inline SerialStub Serial;
+
+struct EspStub
+{
+  uint32_t getFreeHeap() { return 200000; }
+  uint32_t getMinFreeHeap() { return 180000; }
+};
+inline EspStub ESP;
+
+#endif
@@ -0,0 +1,136 @@
+// Host stand-in for the AsyncWebSocket pieces the fan-out uses. Each client
+// has a bounded queue like the real library; tests drain it at whatever rate
+// they want a client to have, and see the shared buffers' reference counts.
+#ifndef STUB_ESPASYNCWEBSERVER_H
+#define STUB_ESPASYNCWEBSERVER_H
+
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+#ifndef WS_MAX_QUEUED_MESSAGES
+#define WS_MAX_QUEUED_MESSAGES 8
+#endif
+
+enum AwsClientStatus
+{
+  WS_DISCONNECTED,
+  WS_CONNECTED,
+  WS_DISCONNECTING
+};
+
+class AsyncWebSocketMessageBuffer
+{
+public:
+  explicit AsyncWebSocketMessageBuffer(size_t len) : data(len) {}
+  uint8_t *get() { return data.data(); }
+  size_t length() const { return data.size(); }
+
+  std::vector<uint8_t> data;
+  int refs = 0;
+};
+
+class AsyncClient
+{
+public:
+  void close(bool = false) { aborted = true; }
+  bool aborted = false;
+};
+
+class AsyncWebSocketClient
+{
+public:
+  explicit AsyncWebSocketClient(uint32_t id) : id_(id) {}
+  ~AsyncWebSocketClient() { drain(queue.size()); }
+
+  uint32_t id() const { return id_; }
+  // An abort only takes effect when the test delivers the disconnect, as on AsyncTCP
+  AwsClientStatus status() const { return closeCode ? WS_DISCONNECTED : WS_CONNECTED; }
+  bool queueIsFull() const { return queue.size() >= WS_MAX_QUEUED_MESSAGES; }
+  AsyncClient *client() { return &tcp; }
+
+  void text(const char *data, size_t len) { queue.push_back({nullptr, std::string(data, len)}); }
+  void text(const String &data) { text(data.c_str(), data.length()); }
+  void text(AsyncWebSocketMessageBuffer *buffer)
+  {
+    buffer->refs++;
+    queue.push_back({buffer, ""});
+  }
+  void close(uint16_t code = 1000, const char * = nullptr) { closeCode = code; }
+
+  // Test side: the peer reads up to n messages off the queue
+  std::vector<std::string> drain(size_t n)
+  {
+    std::vector<std::string> out;
+    while (n-- && !queue.empty())
+    {
+      Queued &q = queue.front();
+      if (q.shared)
+      {
+        out.emplace_back((const char *)q.shared->get(), q.shared->length());
+        q.shared->refs--;
+      }
+      else
+      {
+        out.push_back(q.own);
+      }
+      queue.pop_front();
+    }
+    return out;
+  }
+
+  struct Queued
+  {
+    AsyncWebSocketMessageBuffer *shared;
+    std::string own;
+  };
+  std::deque<Queued> queue;
+  AsyncClient tcp;
+  uint16_t closeCode = 0;
+
+private:
+  uint32_t id_;
+};
+
+class AsyncWebSocket
+{
+public:
+  AsyncWebSocketClient *client(uint32_t id)
+  {
+    for (AsyncWebSocketClient *c : clients)
+    {
+      if (c->id() == id)
+        return c;
+    }
+    return nullptr;
+  }
+
+  AsyncWebSocketMessageBuffer *makeBuffer(size_t len)
+  {
+    buffersMade++;
+    buffers.push_back(new AsyncWebSocketMessageBuffer(len));
+    return buffers.back();
+  }
+
+  void _cleanBuffers()
+  {
+    for (size_t i = 0; i < buffers.size();)
+    {
+      if (buffers[i]->refs == 0)
+      {
+        delete buffers[i];
+        buffers.erase(buffers.begin() + i);
+      }
+      else
+      {
+        i++;
+      }
+    }
+  }
+
+  std::vector<AsyncWebSocketClient *> clients;
+  std::vector<AsyncWebSocketMessageBuffer *> buffers;
+  uint32_t buffersMade = 0;
+};
+
+#endif
@@ -0,0 +1,53 @@
+// Host stand-in for SPIFFS: files live in memory for the life of the test
+#ifndef STUB_SPIFFS_H
+#define STUB_SPIFFS_H
+
+#include <Arduino.h>
+#include <map>
+
+class File
+{
+public:
+  File() {}
+  explicit File(std::string *data) : data_(data) {}
+
+  explicit operator bool() const { return data_ != nullptr; }
+  size_t write(const uint8_t *buf, size_t len)
+  {
+    data_->append((const char *)buf, len);
+    return len;
+  }
+  size_t read(uint8_t *buf, size_t len)
+  {
+    size_t n = std::min(len, data_->size() - pos_);
+    memcpy(buf, data_->data() + pos_, n);
+    pos_ += n;
+    return n;
+  }
+  void close() { data_ = nullptr; }
+
+private:
+  std::string *data_ = nullptr;
+  size_t pos_ = 0;
+};
+
+class SPIFFSStub
+{
+public:
+  bool begin(bool = false) { return true; }
+  File open(const char *path, const char *mode)
+  {
+    if (mode[0] == 'w')
+    {
+      files[path].clear();
+      return File(&files[path]);
+    }
+    auto it = files.find(path);
+    return it == files.end() ? File() : File(&it->second);
+  }
+
+  std::map<std::string, std::string> files;
+};
+inline SPIFFSStub SPIFFS;
+
+#endif
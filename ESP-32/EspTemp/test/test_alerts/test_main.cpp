@@ -0,0 +1,364 @@
+// Replays temperature traces through the alert rules at the firmware's
+// 100 ms sample rate, with DS18B20 9-bit quantization, sensor noise, 85 °C
+// power-on glitches and dropouts. Measures how long each alarm takes to raise
+// and checks that noisy readings near a threshold don't make it flap.
+//
+//   pio test -e native -f test_alerts -v
+
+#include <unity.h>
+#include <vector>
+
+#include "../../src/alert_rules.cpp"
+
+#define SAMPLE_MS 100 // TEMP_UPDATE_INTERVAL in main.cpp
+#define QUANTUM 0.5f  // 9-bit resolution
+#define NOISE 0.15f   // Sensor noise, standard deviation °C
+
+struct Logged
+{
+  uint32_t at;
+  AlertEvent event;
+};
+
+static std::vector<Logged> log_;
+static uint32_t simNow = 0;
+static uint32_t seed = 1;
+
+static void record(const AlertEvent &event) { log_.push_back({simNow, event}); }
+
+static float gaussian()
+{
+  // Sum of uniforms is close enough to normal for sensor noise
+  float sum = 0;
+  for (int i = 0; i < 6; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    sum += (seed >> 8) % 10000 / 10000.0f;
+  }
+  return (sum - 3) * 1.41f;
+}
+
+// What the firmware would read for a given true temperature
+static float sensor(float trueTemp)
+{
+  return roundf((trueTemp + NOISE * gaussian()) / QUANTUM) * QUANTUM;
+}
+
+// Feeds samples until `until`; trueTemp(t) gives the temperature, NAN for no reading
+template <typename F> static void replay(uint32_t until, F trueTemp)
+{
+  for (; simNow < until; simNow += SAMPLE_MS)
+  {
+    float t = trueTemp(simNow);
+    bool valid = !std::isnan(t);
+    alertsEvaluate(valid, valid ? sensor(t) : 0, simNow);
+  }
+}
+
+static void setRule(uint8_t slot, AlertRuleType type, uint8_t priority, float threshold, float hysteresis)
+{
+  AlertRule rule = {type, priority, threshold, hysteresis};
+  TEST_ASSERT_TRUE(alertsSetRule(slot, rule));
+  alertsEvaluate(true, 25, simNow); // Applies the reset of the edited slot
+  log_.clear();
+}
+
+static std::vector<Logged> eventsFor(uint8_t slot)
+{
+  std::vector<Logged> out;
+  for (const Logged &l : log_)
+  {
+    if (l.event.slot == slot)
+      out.push_back(l);
+  }
+  return out;
+}
+
+// Shortest time between two transitions of the same rule
+static uint32_t shortestFlap(uint8_t slot)
+{
+  std::vector<Logged> e = eventsFor(slot);
+  uint32_t shortest = UINT32_MAX;
+  for (size_t i = 1; i < e.size(); i++)
+    shortest = std::min(shortest, e[i].at - e[i - 1].at);
+  return shortest;
+}
+
+void setUp()
+{
+  fakeMicros = 0;
+  simNow = 0;
+  seed = 1;
+  log_.clear();
+  SPIFFS.files.clear();
+  rateCount = 0;
+  rateKnown = false;
+  alertsBegin(record);
+  for (uint8_t i = 0; i < ALERT_MAX_RULES; i++)
+    alertsClearRule(i);
+  alertsEvaluate(true, 25, 0);
+  log_.clear();
+}
+
+void tearDown() {}
+
+void test_step_raises_after_confirm_samples()
+{
+  setRule(0, RULE_HIGH, 2, 35, 0.5f);
+  replay(10000, [](uint32_t) { return 30.0f; });
+  uint32_t stepAt = simNow;
+  replay(20000, [](uint32_t) { return 37.0f; });
+  uint32_t dropAt = simNow;
+  replay(30000, [](uint32_t) { return 32.0f; });
+
+  std::vector<Logged> e = eventsFor(0);
+  TEST_ASSERT_EQUAL(2, e.size());
+  TEST_ASSERT_TRUE(e[0].event.raised);
+  TEST_ASSERT_FALSE(e[1].event.raised);
+
+  char msg[120];
+  snprintf(msg, sizeof(msg), "step 30 -> 37 C: raised after %u ms; 37 -> 32 C: cleared after %u ms", e[0].at - stepAt,
+           e[1].at - dropAt);
+  TEST_MESSAGE(msg);
+
+  // Median and running average first, then the confirm samples
+  TEST_ASSERT_LESS_OR_EQUAL(1500, e[0].at - stepAt);
+  TEST_ASSERT_LESS_OR_EQUAL(1500, e[1].at - dropAt);
+}
+
+// True temperature wandering around the threshold by less than the hysteresis
+static size_t hoverTransitions(float hysteresis, float swing, uint32_t &shortest)
+{
+  setUp();
+  setRule(0, RULE_HIGH, 2, 35, hysteresis);
+  replay(600000, [swing](uint32_t t) { return 35.0f + swing * sinf(t / 20000.0f); });
+  shortest = shortestFlap(0);
+  return eventsFor(0).size();
+}
+
+void test_no_flap_near_threshold()
+{
+  uint32_t shortest;
+  char msg[160];
+  static const float swings[] = {0.2f, 0.4f};
+  size_t counts[2][2];
+  for (int s = 0; s < 2; s++)
+  {
+    for (int h = 0; h < 2; h++)
+    {
+      counts[s][h] = hoverTransitions(h ? 0.5f : 0, swings[s], shortest);
+      snprintf(msg, sizeof(msg), "10 min at 35.0 +/- %.1f C, hysteresis %.1f C: %u transitions, shortest gap %.1f s",
+               swings[s], h ? 0.5f : 0, (unsigned)counts[s][h], shortest == UINT32_MAX ? NAN : shortest / 1000.0f);
+      TEST_MESSAGE(msg);
+    }
+  }
+
+  // Swings inside the hysteresis: raised once and held
+  TEST_ASSERT_LESS_OR_EQUAL(1, counts[0][1]);
+  TEST_ASSERT_LESS_OR_EQUAL(1, counts[1][1]);
+
+  // Without hysteresis it follows the swing, but the filter and confirm
+  // samples still keep it to about one transition per crossing
+  TEST_ASSERT_GREATER_THAN(0, counts[0][0]);
+  TEST_ASSERT_LESS_OR_EQUAL(4 * 600000 / 125664 + 2, counts[1][0]);
+}
+
+// 85.0 is what a DS18B20 returns before its first conversion
+void test_single_sample_glitches_ignored()
+{
+  setRule(0, RULE_HIGH, 2, 35, 0.5f);
+  setRule(1, RULE_STALE, 3, 10, 2);
+  setRule(2, RULE_RATE, 1, 2.0f, 0.5f);
+  setRule(3, RULE_RATE, 1, -2.0f, 0.5f);
+  replay(300000, [](uint32_t t) {
+    if (t % 20000 == 0)
+      return 85.0f;
+    if (t % 150000 == 7000 || t % 150000 == 7100)
+      return NAN; // Rare enough for the rate window to fill in between
+    return 25.0f;
+  });
+  TEST_ASSERT_EQUAL(0, log_.size());
+}
+
+void test_rate_latency()
+{
+  setRule(2, RULE_RATE, 1, 2.0f, 0.5f);
+
+  // 1 °C/min is below the threshold and must stay quiet through the noise
+  replay(300000, [](uint32_t t) { return 20.0f + t / 60000.0f; });
+  TEST_ASSERT_EQUAL(0, log_.size());
+
+  uint32_t start = simNow;
+  replay(start + 300000, [start](uint32_t t) { return 25.0f + 4.0f * (t - start) / 60000.0f; });
+  std::vector<Logged> e = eventsFor(2);
+  TEST_ASSERT_EQUAL(1, e.size());
+  TEST_ASSERT_TRUE(e[0].event.raised);
+  uint32_t latency = e[0].at - start;
+
+  char msg[120];
+  snprintf(msg, sizeof(msg), "rate 1 -> 4 C/min: raised after %.1f s (window %u s)", latency / 1000.0f,
+           ALERT_RATE_WINDOW / 1000);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_LESS_OR_EQUAL(ALERT_RATE_WINDOW / 2, latency);
+}
+
+void test_stale_latency()
+{
+  setRule(0, RULE_HIGH, 2, 35, 0.5f);
+  setRule(1, RULE_STALE, 3, 10, 2);
+  replay(5000, [](uint32_t) { return 25.0f; });
+  uint32_t lostAt = simNow;
+  replay(30000, [](uint32_t) { return NAN; });
+  uint32_t backAt = simNow;
+  replay(40000, [](uint32_t) { return 25.0f; });
+
+  std::vector<Logged> e = eventsFor(1);
+  TEST_ASSERT_EQUAL(2, e.size());
+  TEST_ASSERT_TRUE(e[0].event.raised);
+  TEST_ASSERT_INT_WITHIN(ALERT_CONFIRM_SAMPLES * SAMPLE_MS, 10000 + ALERT_CONFIRM_SAMPLES * SAMPLE_MS, e[0].at - lostAt);
+  TEST_ASSERT_FALSE(e[1].event.raised);
+  TEST_ASSERT_LESS_OR_EQUAL(ALERT_CONFIRM_SAMPLES * SAMPLE_MS, e[1].at - backAt);
+  TEST_ASSERT_EQUAL(0, eventsFor(0).size()); // No reading is not a temperature
+}
+
+void test_simultaneous_alerts_most_urgent_first()
+{
+  setRule(0, RULE_HIGH, 1, 35, 0.5f);
+  setRule(1, RULE_HIGH, 5, 35, 0.5f);
+  setRule(2, RULE_HIGH, 3, 35, 0.5f);
+  replay(5000, [](uint32_t t) { return t < 2000 ? 25.0f : 40.0f; });
+
+  TEST_ASSERT_EQUAL(3, log_.size());
+  TEST_ASSERT_EQUAL(log_[0].at, log_[2].at);
+  TEST_ASSERT_EQUAL(5, log_[0].event.priority);
+  TEST_ASSERT_EQUAL(3, log_[1].event.priority);
+  TEST_ASSERT_EQUAL(1, log_[2].event.priority);
+}
+
+// A day in a tank: slow daily swing, a heater stuck on, a cold draught, a
+// sensor dropout, all with noise and the odd glitch
+void test_day_replay()
+{
+  const uint32_t H = 3600000, M = 60000;
+  setRule(0, RULE_HIGH, 2, 35, 0.5f);
+  setRule(1, RULE_LOW, 2, 10, 0.5f);
+  setRule(2, RULE_RATE, 1, -2.0f, 0.5f); // Falling faster than 2 °C/min
+  setRule(3, RULE_STALE, 3, 10, 2);
+
+  // Heater: +1 °C/min up to +13, held until 7:00, then cools at 0.5 °C/min.
+  // Draught: -3 °C/min for 5 min, held 10 min, then recovers at 1 °C/min.
+  auto heater = [H, M](uint32_t t) {
+    if (t < 6 * H)
+      return 0.0f;
+    if (t < 7 * H)
+      return std::min(13.0f, (t - 6 * H) / (float)M);
+    return std::max(0.0f, 13.0f - 0.5f * (t - 7 * H) / M);
+  };
+  auto draught = [H, M](uint32_t t) {
+    if (t < 19 * H)
+      return 0.0f;
+    if (t < 19 * H + 15 * M)
+      return std::min(15.0f, 3.0f * (t - 19 * H) / M);
+    return std::max(0.0f, 15.0f - (t - 19 * H - 15 * M) / (float)M);
+  };
+  auto day = [H, heater, draught](uint32_t t) {
+    if (t >= 14 * H && t < 14 * H + 30000)
+      return NAN; // Loose connector
+    if (t % 600000 == 300000)
+      return 85.0f;
+    return 24.0f + 3.0f * sinf(t * 6.2832f / (24.0f * H)) + heater(t) - draught(t);
+  };
+
+  // When the true temperature first crossed each threshold
+  uint32_t hotAt = 0, coldAt = 0;
+  for (uint32_t t = 0; t < 24 * H && !(hotAt && coldAt); t += SAMPLE_MS)
+  {
+    float temp = 24.0f + 3.0f * sinf(t * 6.2832f / (24.0f * H)) + heater(t) - draught(t);
+    if (!hotAt && temp > 35)
+      hotAt = t;
+    if (!coldAt && temp < 10)
+      coldAt = t;
+  }
+
+  replay(24 * H, day);
+
+  std::vector<Logged> high = eventsFor(0), low = eventsFor(1), rate = eventsFor(2), stale = eventsFor(3);
+  TEST_ASSERT_EQUAL(2, high.size());
+  TEST_ASSERT_EQUAL(2, low.size());
+  TEST_ASSERT_EQUAL(2, rate.size()); // Only the draught falls that fast
+  TEST_ASSERT_EQUAL(2, stale.size());
+
+  char msg[200];
+  snprintf(msg, sizeof(msg), "day: raised after crossing high %.1f s, low %.1f s; rate %.1f s into the draught; stale %.1f s",
+           (high[0].at - hotAt) / 1000.0f, (low[0].at - coldAt) / 1000.0f, (rate[0].at - 19 * H) / 1000.0f,
+           (stale[0].at - 14 * H) / 1000.0f);
+  TEST_MESSAGE(msg);
+  // Stale follows the 30 s dropout by design, the others must not flap
+  uint32_t shortest = std::min(std::min(shortestFlap(0), shortestFlap(1)), shortestFlap(2));
+  snprintf(msg, sizeof(msg), "day: shortest time between transitions of a temperature rule %.1f s", shortest / 1000.0f);
+  TEST_MESSAGE(msg);
+
+  // The first reading past a threshold needs the next 0.5 °C step: 30 s on a
+  // 1 °C/min ramp, 10 s at 3 °C/min, plus the confirm samples
+  TEST_ASSERT_LESS_OR_EQUAL(30000 + ALERT_CONFIRM_SAMPLES * SAMPLE_MS, high[0].at - hotAt);
+  TEST_ASSERT_LESS_OR_EQUAL(10000 + ALERT_CONFIRM_SAMPLES * SAMPLE_MS, low[0].at - coldAt);
+  TEST_ASSERT_LESS_OR_EQUAL(ALERT_RATE_WINDOW, rate[0].at - 19 * H);
+  TEST_ASSERT_GREATER_THAN(60000, shortest);
+}
+
+void test_rules_survive_reboot()
+{
+  setRule(5, RULE_LOW, 7, 12.5f, 1);
+  memset(rules, 0, sizeof(rules));
+  alertsBegin(record);
+  TEST_ASSERT_EQUAL(RULE_LOW, rules[5].type);
+  TEST_ASSERT_EQUAL(7, rules[5].priority);
+  TEST_ASSERT_FALSE(alertsSetRule(ALERT_MAX_RULES, rules[5]));
+}
+
+void test_rejects_non_finite_and_out_of_range_rules()
+{
+  const AlertRule bad[] = {
+      {RULE_HIGH, 1, NAN, 0.5f},
+      {RULE_HIGH, 1, INFINITY, 0.5f},
+      {RULE_LOW, 1, -INFINITY, 0.5f},
+      {RULE_HIGH, 1, 35, NAN},
+      {RULE_HIGH, 1, 35, -1},
+      {RULE_HIGH, 1, 126, 0.5f},
+      {RULE_LOW, 1, -56, 0.5f},
+      {RULE_RATE, 1, 0, 0.5f},
+      {RULE_RATE, 1, 1000, 0.5f},
+      {RULE_STALE, 1, 0, 0},
+      {RULE_STALE, 1, ALERT_STALE_MAX + 1, 0},
+      {RULE_NONE, 1, 35, 0.5f},
+  };
+  for (const AlertRule &rule : bad)
+    TEST_ASSERT_FALSE(alertsSetRule(0, rule));
+  TEST_ASSERT_EQUAL(RULE_NONE, rules[0].type);
+
+  setRule(0, RULE_HIGH, 1, ALERT_TEMP_MAX, 0.5f);
+  setRule(1, RULE_LOW, 1, ALERT_TEMP_MIN, 0.5f);
+  setRule(2, RULE_RATE, 1, -0.1f, 0);
+
+  // A NaN that reached flash before this check is dropped on load
+  rules[3] = {RULE_HIGH, 1, NAN, 0.5f};
+  saveRules();
+  alertsBegin(record);
+  TEST_ASSERT_EQUAL(RULE_NONE, rules[3].type);
+  TEST_ASSERT_EQUAL(RULE_HIGH, rules[0].type);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_step_raises_after_confirm_samples);
+  RUN_TEST(test_no_flap_near_threshold);
+  RUN_TEST(test_single_sample_glitches_ignored);
+  RUN_TEST(test_rate_latency);
+  RUN_TEST(test_stale_latency);
+  RUN_TEST(test_simultaneous_alerts_most_urgent_first);
+  RUN_TEST(test_day_replay);
+  RUN_TEST(test_rules_survive_reboot);
+  RUN_TEST(test_rejects_non_finite_and_out_of_range_rules);
+  return UNITY_END();
+}
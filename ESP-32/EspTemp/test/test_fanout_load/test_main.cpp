@@ -0,0 +1,334 @@
+// Load test for the WebSocket fan-out with 1 to 100 simulated clients: most
+// read as fast as frames come, some are slower than the 100 ms broadcast rate
+// and a few stop reading altogether. Checks that every live client keeps
+// getting the newest frame and every alert, that only stalled clients are
+// evicted (once, even though the disconnect arrives later), and that each
+// broadcast allocates one shared buffer.
+//
+//   pio test -e native -f test_fanout_load -v
+
+#define WS_FANOUT_MAX_CLIENTS 100
+
+#include <chrono>
+#include <unity.h>
+
+#include "../../src/ws_fanout.cpp"
+
+#define BROADCAST_MS 100 // TEMP_UPDATE_INTERVAL in main.cpp
+#define ALERT_EVERY_MS 5000
+#define RUN_MS 60000
+#define STEP_MS 10
+#define SLOW_READ_MS 250 // A slow client takes one message per this
+#define STALL_AFTER_MS 1000
+#define DISCONNECT_LAG_MS 350 // Abort to disconnect callback, spans several broadcasts
+
+enum Kind : uint8_t
+{
+  FAST,
+  SLOW,
+  STALLED
+};
+
+struct Peer
+{
+  AsyncWebSocketClient *ws;
+  Kind kind;
+  uint32_t frames;
+  int32_t lastFrame;    // Sequence number in the newest frame seen
+  uint32_t maxFrameAge; // ms from broadcast to read
+  uint32_t alerts;
+  int32_t lastAlert;
+  uint32_t maxAlertAge;
+  bool outOfOrder;
+  uint32_t evictedAt; // When the abort was seen
+};
+
+struct LoadResult
+{
+  uint32_t broadcasts;
+  double usPerBroadcast; // Host CPU time
+  uint32_t maxLiveBuffers;
+  uint32_t peakSharedBytes; // Held by the shared buffers
+  uint32_t peakCopyBytes;   // What one copy per queued frame would hold
+  uint32_t statsEntries;
+  uint32_t maxAge[3];
+  uint32_t maxAlertAge[3];
+};
+
+static AsyncWebSocket server;
+static std::vector<Peer> peers;
+static uint32_t frameSentAt[RUN_MS / BROADCAST_MS + 2];
+static uint32_t alertSentAt[RUN_MS / ALERT_EVERY_MS + 2];
+
+static uint32_t nowMs() { return fakeMicros / 1000; }
+
+static Kind kindFor(int i)
+{
+  if (i % 20 == 19)
+    return STALLED;
+  if (i % 20 == 3 || i % 20 == 9 || i % 20 == 15)
+    return SLOW;
+  return FAST;
+}
+
+static void read(Peer &p, size_t n)
+{
+  for (const std::string &m : p.ws->drain(n))
+  {
+    int seq;
+    if (sscanf(m.c_str(), "{\"alert\":\"test\",\"seq\":%d}", &seq) == 1)
+    {
+      p.outOfOrder |= seq != p.lastAlert + 1;
+      p.lastAlert = seq;
+      p.alerts++;
+      p.maxAlertAge = std::max(p.maxAlertAge, nowMs() - alertSentAt[seq]);
+    }
+    else if (sscanf(m.c_str(), "{\"temperature\":%d", &seq) == 1)
+    {
+      p.outOfOrder |= seq <= p.lastFrame;
+      p.lastFrame = seq;
+      p.frames++;
+      p.maxFrameAge = std::max(p.maxFrameAge, nowMs() - frameSentAt[seq]);
+    }
+  }
+}
+
+static uint32_t countOf(const String &s, const char *needle)
+{
+  uint32_t n = 0;
+  for (int at = s.indexOf(needle); at >= 0; at = s.indexOf(needle, at + 1))
+    n++;
+  return n;
+}
+
+static LoadResult runLoad(int count)
+{
+  LoadResult r = {};
+  fakeMicros = 0;
+  fanoutBegin(&server);
+  peers.clear();
+
+  for (int i = 0; i < count; i++)
+  {
+    AsyncWebSocketClient *c = new AsyncWebSocketClient(i + 1);
+    server.clients.push_back(c);
+    TEST_ASSERT_TRUE(fanoutOnConnect(c));
+    peers.push_back({c, kindFor(i), 0, -1, 0, 0, -1, 0, false, 0});
+  }
+  r.statsEntries = countOf(fanoutStatsJson(), "\"sinceProgressMs\":");
+
+  char frame[64], alert[64];
+  uint32_t alertsPushed = 0;
+  double cpuUs = 0;
+
+  for (uint32_t t = 0; t < RUN_MS; t += STEP_MS)
+  {
+    fakeMicros = t * 1000;
+
+    if (t % ALERT_EVERY_MS == ALERT_EVERY_MS / 2)
+    {
+      alertSentAt[alertsPushed] = t;
+      int len = snprintf(alert, sizeof(alert), "{\"alert\":\"test\",\"seq\":%u}", alertsPushed);
+      fanoutPushAlert(alert, len);
+      alertsPushed++;
+    }
+
+    if (t % BROADCAST_MS == 0)
+    {
+      uint32_t seq = r.broadcasts;
+      frameSentAt[seq] = t;
+      int len = snprintf(frame, sizeof(frame), "{\"temperature\":%u,\"status\":\"ok\"}", seq);
+      auto start = std::chrono::steady_clock::now();
+      fanoutBroadcast(frame, len);
+      cpuUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+      r.broadcasts++;
+
+      uint32_t queued = 0;
+      for (const Peer &p : peers)
+      {
+        if (p.ws)
+          for (const auto &q : p.ws->queue)
+            queued += q.shared ? q.shared->length() : 0;
+      }
+      uint32_t shared = 0;
+      for (AsyncWebSocketMessageBuffer *b : server.buffers)
+        shared += b->length();
+      r.peakSharedBytes = std::max(r.peakSharedBytes, shared);
+      r.peakCopyBytes = std::max(r.peakCopyBytes, queued);
+      r.maxLiveBuffers = std::max(r.maxLiveBuffers, (uint32_t)server.buffers.size());
+    }
+
+    for (Peer &p : peers)
+    {
+      if (!p.ws)
+        continue;
+
+      // The AsyncTCP task reports the abort as a disconnect, some time later;
+      // until then the client still looks connected
+      if (p.ws->tcp.aborted && !p.evictedAt)
+        p.evictedAt = t;
+      if (p.evictedAt && t - p.evictedAt >= DISCONNECT_LAG_MS)
+      {
+        fanoutOnDisconnect(p.ws);
+        server.clients.erase(std::find(server.clients.begin(), server.clients.end(), p.ws));
+        delete p.ws;
+        p.ws = nullptr;
+        continue;
+      }
+
+      if (p.kind == FAST || (p.kind == STALLED && t < STALL_AFTER_MS))
+        read(p, WS_MAX_QUEUED_MESSAGES);
+      else if (p.kind == SLOW && t % SLOW_READ_MS == 0)
+        read(p, 1);
+    }
+  }
+
+  r.usPerBroadcast = cpuUs / r.broadcasts;
+  uint32_t stalled = 0;
+
+  for (const Peer &p : peers)
+  {
+    r.maxAge[p.kind] = std::max(r.maxAge[p.kind], p.maxFrameAge);
+    r.maxAlertAge[p.kind] = std::max(r.maxAlertAge[p.kind], p.maxAlertAge);
+
+    TEST_ASSERT_FALSE(p.outOfOrder);
+    if (p.kind == STALLED)
+    {
+      // Evicted once its queue has filled up and stayed full for the stall timeout
+      uint32_t full = STALL_AFTER_MS + WS_MAX_QUEUED_MESSAGES * BROADCAST_MS;
+      TEST_ASSERT_NULL(p.ws);
+      TEST_ASSERT_GREATER_OR_EQUAL(full + WS_FANOUT_STALL_TIMEOUT - BROADCAST_MS, p.evictedAt);
+      TEST_ASSERT_LESS_OR_EQUAL(full + WS_FANOUT_STALL_TIMEOUT + 2 * BROADCAST_MS, p.evictedAt);
+      stalled++;
+      continue;
+    }
+
+    TEST_ASSERT_NOT_NULL(p.ws);
+    TEST_ASSERT_EQUAL(alertsPushed, p.alerts);
+    if (p.kind == FAST)
+      TEST_ASSERT_EQUAL(r.broadcasts, p.frames);
+    else
+      TEST_ASSERT_GREATER_THAN(r.broadcasts * BROADCAST_MS / SLOW_READ_MS / 2, p.frames);
+  }
+
+  // Each stalled client is evicted once, not on every broadcast before its disconnect
+  TEST_ASSERT_EQUAL(stalled, stats.evicted);
+
+  // One buffer per broadcast, shared by every client it was queued on
+  TEST_ASSERT_EQUAL(r.broadcasts, server.buffersMade);
+  // Slow readers hold a queue's worth of recent frames, a stalled one a
+  // queue's worth of old ones until it is evicted
+  TEST_ASSERT_LESS_OR_EQUAL(2 * WS_MAX_QUEUED_MESSAGES + 1, r.maxLiveBuffers);
+  TEST_ASSERT_LESS_OR_EQUAL(r.peakCopyBytes, r.peakSharedBytes);
+  TEST_ASSERT_EQUAL(count, r.statsEntries);
+
+  // Per-client stats match what the peers saw
+  String json = fanoutStatsJson();
+  for (const Peer &p : peers)
+  {
+    if (!p.ws)
+      continue;
+    const FanoutClient *c = nullptr;
+    for (const FanoutClient &fc : clients)
+      c = fc.id == p.ws->id() ? &fc : c;
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_EQUAL(r.broadcasts, c->sent + c->skipped);
+    char entry[96];
+    snprintf(entry, sizeof(entry), "{\"id\":%u,\"sent\":%u,\"skipped\":%u,", c->id, c->sent, c->skipped);
+    TEST_ASSERT_TRUE(json.indexOf(entry) >= 0);
+  }
+
+  // Everyone leaves, nothing is left queued or allocated
+  for (Peer &p : peers)
+  {
+    if (!p.ws)
+      continue;
+    fanoutOnDisconnect(p.ws);
+    delete p.ws;
+    p.ws = nullptr;
+  }
+  server.clients.clear();
+  server._cleanBuffers();
+  TEST_ASSERT_EQUAL(0, server.buffers.size());
+  server.buffersMade = 0;
+  return r;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_load_1_to_100_clients()
+{
+  static const int counts[] = {1, 10, 25, 50, 100};
+  char msg[200];
+  TEST_MESSAGE("clients  us/broadcast  buffers  shared/copied bytes  max frame age fast/slow ms  max alert age fast/slow ms");
+  for (int n : counts)
+  {
+    LoadResult r = runLoad(n);
+    snprintf(msg, sizeof(msg), "%7d  %12.2f  %7u  %6u / %6u      %5u / %5u                 %5u / %5u", n,
+             r.usPerBroadcast, r.maxLiveBuffers, r.peakSharedBytes, r.peakCopyBytes, r.maxAge[FAST], r.maxAge[SLOW],
+             r.maxAlertAge[FAST], r.maxAlertAge[SLOW]);
+    TEST_MESSAGE(msg);
+  }
+}
+
+void test_refuses_clients_over_limit()
+{
+  fanoutBegin(&server);
+  std::vector<AsyncWebSocketClient *> extra;
+  for (int i = 0; i <= WS_FANOUT_MAX_CLIENTS; i++)
+  {
+    extra.push_back(new AsyncWebSocketClient(1000 + i));
+    bool added = fanoutOnConnect(extra.back());
+    TEST_ASSERT_EQUAL(i < WS_FANOUT_MAX_CLIENTS, added);
+  }
+  TEST_ASSERT_EQUAL(1013, extra.back()->closeCode);
+  for (AsyncWebSocketClient *c : extra)
+  {
+    fanoutOnDisconnect(c);
+    delete c;
+  }
+}
+
+// setup() returns before fanoutBegin() when SPIFFS or WiFi fails, loop() still broadcasts
+void test_broadcast_before_begin_is_ignored()
+{
+  ws = nullptr;
+  memset(&stats, 0, sizeof(stats));
+  fanoutBroadcast("{}", 2);
+  fanoutPushAlert("{}", 2);
+  TEST_ASSERT_EQUAL(0, stats.broadcasts);
+  TEST_ASSERT_EQUAL(0, stats.alertsSent);
+}
+
+void test_oversized_alert_is_counted_not_sent()
+{
+  fakeMicros = 0;
+  fanoutBegin(&server);
+  AsyncWebSocketClient c(1);
+  server.clients.push_back(&c);
+  TEST_ASSERT_TRUE(fanoutOnConnect(&c));
+
+  char big[WS_FANOUT_ALERT_LEN + 2];
+  memset(big, 'x', sizeof(big));
+  TEST_ASSERT_FALSE(fanoutPushAlert(big, sizeof(big)));
+  TEST_ASSERT_TRUE(fanoutPushAlert(big, WS_FANOUT_ALERT_LEN));
+  fanoutCountRejectedAlert();
+
+  TEST_ASSERT_EQUAL(1, c.queue.size());
+  TEST_ASSERT_EQUAL(WS_FANOUT_ALERT_LEN, c.queue.front().own.size());
+  TEST_ASSERT_TRUE(fanoutStatsJson().indexOf("\"alertsSent\":1,\"alertsDropped\":0,\"alertsRejected\":2,") >= 0);
+
+  fanoutOnDisconnect(&c);
+  server.clients.clear();
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_broadcast_before_begin_is_ignored);
+  RUN_TEST(test_refuses_clients_over_limit);
+  RUN_TEST(test_oversized_alert_is_counted_not_sent);
+  RUN_TEST(test_load_1_to_100_clients);
+  return UNITY_END();
+}
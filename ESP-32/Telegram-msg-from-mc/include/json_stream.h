@@ -0,0 +1,79 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <Arduino.h>
+
+#define JSON_STREAM_MAX_TOKEN 127 // Longer strings are truncated
+#define JSON_STREAM_MAX_DEPTH 16
+
+enum JsonToken : uint8_t
+{
+    JSON_OBJECT_START,
+    JSON_OBJECT_END,
+    JSON_ARRAY_START,
+    JSON_ARRAY_END,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL
+};
+
+// Incremental JSON tokenizer. Bytes are pushed in one at a time (it is a Print,
+// so HTTPClient::writeToStream can feed it straight from the socket) and every
+// token is reported through the handler. Nothing is allocated: the only buffer
+// is the fixed token buffer below.
+//
+// depth is the nesting level of the container the token belongs to; for
+// *_START and *_END it is the level of the container being opened or closed.
+class JsonStream : public Print
+{
+public:
+    typedef void (*TokenHandler)(void *ctx, JsonToken token, const char *text, uint8_t depth);
+
+    JsonStream(TokenHandler handler, void *ctx);
+
+    void reset();
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    bool failed() const { return state == ST_ERROR; }
+
+private:
+    enum State : uint8_t
+    {
+        ST_IDLE,
+        ST_STRING,
+        ST_ESCAPE,
+        ST_UNICODE,
+        ST_NUMBER,
+        ST_LITERAL,
+        ST_ERROR
+    };
+
+    void push(bool isObject);
+    bool pop(bool isObject);
+    bool inObject() const { return depth > 0 && (objectBits >> (depth - 1)) & 1; }
+    void append(char c);
+    void appendUtf8(uint32_t cp);
+    void emit(JsonToken token, uint8_t atDepth);
+    void emitLiteral();
+
+    TokenHandler handler;
+    void *ctx;
+
+    State state;
+    uint8_t depth;
+    uint16_t objectBits; // bit n set when level n+1 is an object
+    bool expectKey;
+    bool stringIsKey;
+    uint8_t hexDigits;
+    uint32_t codepoint;
+    uint16_t highSurrogate;
+
+    char token[JSON_STREAM_MAX_TOKEN + 1];
+    uint8_t length;
+};
+
+#endif
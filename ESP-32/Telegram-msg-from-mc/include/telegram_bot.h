@@ -0,0 +1,33 @@
+#ifndef TELEGRAM_BOT_H
+#define TELEGRAM_BOT_H
+
+#include <Arduino.h>
+
+#define BOT_MAX_COMMANDS 8
+#define BOT_MAX_PENDING 4  // Updates fetched per long-poll
+#define BOT_POLL_TIMEOUT 50 // Seconds Telegram may hold a getUpdates open
+
+// args points past the command word (may be empty), reply is sent back to the chat
+typedef void (*CommandHandler)(const char *args, String &reply);
+
+struct BotStats
+{
+    uint32_t polls;
+    uint32_t pollErrors;
+    uint32_t commands;
+    uint32_t lastCommandMs;  // Dispatch + reply time of the last command
+    uint32_t maxCommandMs;
+    uint64_t pollMs;         // Wall time inside getUpdates calls (server hold, TLS, transfer)
+    uint32_t minFreeHeap;    // Low-water mark since boot
+    uint32_t ticks;          // FreeRTOS ticks on the loop's core since botBegin
+    uint32_t idleTicks;      // Of those, ticks that found the idle task running
+};
+
+void botBegin(const String &token, const String &chatId);
+bool botOnCommand(const char *command, CommandHandler handler);
+void botPoll();
+void botConfirmUpdates();
+bool botSendMessage(const String &text);
+const BotStats &botStats();
+
+#endif
@@ -0,0 +1,269 @@
+#include "json_stream.h"
+
+JsonStream::JsonStream(TokenHandler handler, void *ctx) : handler(handler), ctx(ctx)
+{
+    reset();
+}
+
+void JsonStream::reset()
+{
+    state = ST_IDLE;
+    depth = 0;
+    objectBits = 0;
+    expectKey = false;
+    stringIsKey = false;
+    hexDigits = 0;
+    codepoint = 0;
+    highSurrogate = 0;
+    length = 0;
+}
+
+void JsonStream::push(bool isObject)
+{
+    if (depth >= JSON_STREAM_MAX_DEPTH)
+    {
+        state = ST_ERROR;
+        return;
+    }
+    if (isObject)
+        objectBits |= 1 << depth;
+    else
+        objectBits &= ~(1 << depth);
+    depth++;
+}
+
+bool JsonStream::pop(bool isObject)
+{
+    if (depth == 0 || inObject() != isObject)
+        return false;
+    depth--;
+    return true;
+}
+
+void JsonStream::append(char c)
+{
+    if (length < JSON_STREAM_MAX_TOKEN)
+        token[length++] = c;
+}
+
+void JsonStream::appendUtf8(uint32_t cp)
+{
+    if (cp < 0x80)
+    {
+        append(cp);
+    }
+    else if (cp < 0x800)
+    {
+        append(0xC0 | (cp >> 6));
+        append(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        append(0xE0 | (cp >> 12));
+        append(0x80 | ((cp >> 6) & 0x3F));
+        append(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        append(0xF0 | (cp >> 18));
+        append(0x80 | ((cp >> 12) & 0x3F));
+        append(0x80 | ((cp >> 6) & 0x3F));
+        append(0x80 | (cp & 0x3F));
+    }
+}
+
+void JsonStream::emit(JsonToken type, uint8_t atDepth)
+{
+    token[length] = '\0';
+    handler(ctx, type, token, atDepth);
+    length = 0;
+}
+
+void JsonStream::emitLiteral()
+{
+    token[length] = '\0';
+    if (strcmp(token, "true") == 0)
+        emit(JSON_TRUE, depth);
+    else if (strcmp(token, "false") == 0)
+        emit(JSON_FALSE, depth);
+    else if (strcmp(token, "null") == 0)
+        emit(JSON_NULL, depth);
+    else
+        state = ST_ERROR;
+}
+
+size_t JsonStream::write(uint8_t c)
+{
+    // Always report the byte as consumed so the HTTP body is drained even after
+    // a parse error, otherwise the kept-alive connection would be torn down.
+    switch (state)
+    {
+    case ST_ERROR:
+        return 1;
+
+    case ST_STRING:
+        if (c == '\\')
+        {
+            state = ST_ESCAPE;
+        }
+        else if (c == '"')
+        {
+            state = ST_IDLE;
+            emit(stringIsKey ? JSON_KEY : JSON_STRING, depth);
+        }
+        else
+        {
+            append(c);
+        }
+        return 1;
+
+    case ST_ESCAPE:
+        state = ST_STRING;
+        switch (c)
+        {
+        case 'n':
+            append('\n');
+            break;
+        case 't':
+            append('\t');
+            break;
+        case 'r':
+            append('\r');
+            break;
+        case 'b':
+            append('\b');
+            break;
+        case 'f':
+            append('\f');
+            break;
+        case 'u':
+            state = ST_UNICODE;
+            hexDigits = 0;
+            codepoint = 0;
+            break;
+        default: // \" \\ \/
+            append(c);
+            break;
+        }
+        return 1;
+
+    case ST_UNICODE:
+        if (!isxdigit(c))
+        {
+            state = ST_ERROR;
+            return 1;
+        }
+        codepoint = (codepoint << 4) | (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+        if (++hexDigits < 4)
+            return 1;
+
+        state = ST_STRING;
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+        {
+            // First half of an emoji, wait for the low surrogate
+            highSurrogate = codepoint;
+            return 1;
+        }
+        if (codepoint >= 0xDC00 && codepoint <= 0xDFFF && highSurrogate)
+            codepoint = 0x10000 + ((uint32_t)(highSurrogate - 0xD800) << 10) + (codepoint - 0xDC00);
+        highSurrogate = 0;
+        appendUtf8(codepoint);
+        return 1;
+
+    case ST_NUMBER:
+        if (isdigit(c) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+        {
+            append(c);
+            return 1;
+        }
+        state = ST_IDLE;
+        emit(JSON_NUMBER, depth);
+        break; // c still has to be handled below
+
+    case ST_LITERAL:
+        if (isalpha(c))
+        {
+            append(c);
+            return 1;
+        }
+        state = ST_IDLE;
+        emitLiteral();
+        if (state == ST_ERROR)
+            return 1;
+        break;
+
+    case ST_IDLE:
+        break;
+    }
+
+    switch (c)
+    {
+    case '{':
+        push(true);
+        expectKey = true;
+        if (state != ST_ERROR)
+            emit(JSON_OBJECT_START, depth);
+        break;
+
+    case '[':
+        push(false);
+        expectKey = false;
+        if (state != ST_ERROR)
+            emit(JSON_ARRAY_START, depth);
+        break;
+
+    case '}':
+    case ']':
+    {
+        uint8_t closing = depth;
+        if (!pop(c == '}'))
+        {
+            state = ST_ERROR;
+            break;
+        }
+        expectKey = false;
+        emit(c == '}' ? JSON_OBJECT_END : JSON_ARRAY_END, closing);
+        break;
+    }
+
+    case ',':
+        expectKey = inObject();
+        break;
+
+    case ':':
+        expectKey = false;
+        break;
+
+    case '"':
+        stringIsKey = expectKey && inObject();
+        highSurrogate = 0;
+        length = 0;
+        state = ST_STRING;
+        break;
+
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+        break;
+
+    default:
+        length = 0;
+        if (c == '-' || isdigit(c))
+        {
+            append(c);
+            state = ST_NUMBER;
+        }
+        else if (c == 't' || c == 'f' || c == 'n')
+        {
+            append(c);
+            state = ST_LITERAL;
+        }
+        else
+        {
+            state = ST_ERROR;
+        }
+        break;
+    }
+    return 1;
+}
@@ -1,17 +1,42 @@
 #include <WiFi.h>
-#include <HTTPClient.h>
-#include <WiFiClientSecure.h>
 #include "config.h"
+#include "telegram_bot.h"
 
 // WiFi credentials
 const char *ssid = WIFI_SSID;
 const char *password = WIFI_PASS;
 // Telegram bot token and chat ID
 String botToken = BOT_TOKEN;
-String chatId = CHAT_ID; // Your chat ID
+String chatId = CHAT_ID; // Only commands from this chat are accepted
 
-unsigned long previousMillis = 0;
-const long interval = 5000; // 5 seconds
+bool rebootRequested = false;
+
+void handleStatus(const char *args, String &reply)
+{
+    const BotStats &stats = botStats();
+    unsigned long uptime = millis();
+
+    reply = "Uptime: " + String(uptime / 1000) + " s\n";
+    reply += "WiFi: " + WiFi.localIP().toString() + " (" + String(WiFi.RSSI()) + " dBm)\n";
+    reply += "Heap: " + String(ESP.getFreeHeap()) + " free, " + String(stats.minFreeHeap) + " min\n";
+    reply += "Polls: " + String(stats.polls) + " (" + String(stats.pollErrors) + " errors)\n";
+    reply += "Commands: " + String(stats.commands) + ", last " + String(stats.lastCommandMs) +
+             " ms, max " + String(stats.maxCommandMs) + " ms\n";
+    reply += "CPU idle: " + String(stats.ticks ? 100.0 * stats.idleTicks / stats.ticks : 0.0, 1) + " % (loop core)\n";
+    // Wall time inside getUpdates, including TLS and transfer, not a CPU idle figure
+    reply += "Time in long-poll: " + String(100.0 * stats.pollMs / uptime, 1) + " % of uptime";
+}
+
+void handleReboot(const char *args, String &reply)
+{
+    reply = "Rebooting...";
+    rebootRequested = true;
+}
+
+void handleHelp(const char *args, String &reply)
+{
+    reply = "/status - uptime, WiFi, heap and bot stats\n/reboot - restart the board";
+}
 
 void setup()
 {
@@ -25,51 +50,33 @@ void setup()
         Serial.print(".");
     }
     Serial.println("\nConnected to WiFi");
+
+    botBegin(botToken, chatId);
+    botOnCommand("/status", handleStatus);
+    botOnCommand("/reboot", handleReboot);
+    botOnCommand("/help", handleHelp);
+    botOnCommand("/start", handleHelp);
+
+    botSendMessage("Hello from ESP-32");
 }
 
 void loop()
 {
-    unsigned long currentMillis = millis();
-
-    if (currentMillis - previousMillis >= interval)
+    if (WiFi.status() != WL_CONNECTED)
     {
-        previousMillis = currentMillis;
-
-        if (WiFi.status() == WL_CONNECTED)
-        {
-            WiFiClientSecure client;
-            client.setInsecure(); // This skips certificate validation, quick and works.
-
-            HTTPClient http;
-
-            String message = "Hello from ESP-32";
-            String url = "https://api.telegram.org/bot" + botToken + "/sendMessage?chat_id=" + chatId + "&text=" + message;
-
-            Serial.println("Sending message to: " + url);
-
-            http.begin(client, url); // Use secure client
-            int httpResponseCode = http.GET();
-
-            if (httpResponseCode > 0)
-            {
-                Serial.print("HTTP Response code: ");
-                Serial.println(httpResponseCode);
+        Serial.println("WiFi not connected, attempting reconnect...");
+        WiFi.reconnect();
+        delay(5000);
+        return;
+    }
 
-                String response = http.getString();
-                Serial.println("Response payload: " + response);
-            }
-            else
-            {
-                Serial.print("Error code: ");
-                Serial.println(httpResponseCode);
-            }
+    // Blocks for up to BOT_POLL_TIMEOUT seconds, returns as soon as a command arrives
+    botPoll();
 
-            http.end(); // Properly close connection
-        }
-        else
-        {
-            Serial.println("WiFi not connected, attempting reconnect...");
-            WiFi.reconnect();
-        }
+    if (rebootRequested)
+    {
+        botConfirmUpdates();
+        delay(500);
+        ESP.restart();
     }
 }
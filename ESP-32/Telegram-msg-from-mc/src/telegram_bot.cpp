@@ -0,0 +1,321 @@
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <freertos/task.h>
+#include <esp_freertos_hooks.h>
+#include "telegram_bot.h"
+#include "json_stream.h"
+
+// Telegram keeps the request open for up to BOT_POLL_TIMEOUT, give it some slack
+#define BOT_HTTP_TIMEOUT ((BOT_POLL_TIMEOUT + 10) * 1000)
+#define BOT_RETRY_DELAY 2000
+
+struct Command
+{
+    const char *name;
+    CommandHandler handler;
+};
+
+struct PendingUpdate
+{
+    int64_t chatId;
+    char text[JSON_STREAM_MAX_TOKEN + 1];
+};
+
+// Only the keys we care about get an id, everything else is KEY_OTHER
+enum Key : uint8_t
+{
+    KEY_OTHER,
+    KEY_OK,
+    KEY_RESULT,
+    KEY_UPDATE_ID,
+    KEY_MESSAGE,
+    KEY_CHAT,
+    KEY_ID,
+    KEY_TEXT
+};
+
+// One TLS connection, kept alive across every call, so the handshake is paid once
+static WiFiClientSecure client;
+static HTTPClient http;
+
+static String apiBase;
+static String chatIdParam;
+static int64_t allowedChatId = 0;
+static Command commands[BOT_MAX_COMMANDS];
+static uint8_t commandCount = 0;
+static int64_t nextOffset = 0;
+static BotStats stats;
+
+// CPU idle time on the core running loop(): every tick the hook checks whether
+// that core's idle task was the one interrupted
+static BaseType_t loopCore = 0;
+static TaskHandle_t idleTask = nullptr;
+static volatile uint32_t ticks = 0, idleTicks = 0;
+
+// Parse state for the response currently being streamed in.
+// Response shape: {"ok":true,"result":[{"update_id":1,"message":{"chat":{"id":2},"text":"/status"}}]}
+static uint8_t keyAt[JSON_STREAM_MAX_DEPTH + 1];
+static bool responseOk = false;
+static bool responseComplete = false; // Top-level object closed, body not cut short
+static bool collectUpdates = false;
+static PendingUpdate current;
+static PendingUpdate pending[BOT_MAX_PENDING];
+static uint8_t pendingCount = 0;
+
+static Key keyFor(const char *name)
+{
+    if (strcmp(name, "ok") == 0)
+        return KEY_OK;
+    if (strcmp(name, "result") == 0)
+        return KEY_RESULT;
+    if (strcmp(name, "update_id") == 0)
+        return KEY_UPDATE_ID;
+    if (strcmp(name, "message") == 0)
+        return KEY_MESSAGE;
+    if (strcmp(name, "chat") == 0)
+        return KEY_CHAT;
+    if (strcmp(name, "id") == 0)
+        return KEY_ID;
+    if (strcmp(name, "text") == 0)
+        return KEY_TEXT;
+    return KEY_OTHER;
+}
+
+static void onToken(void *, JsonToken token, const char *text, uint8_t depth)
+{
+    bool inUpdate = collectUpdates && keyAt[1] == KEY_RESULT;
+
+    switch (token)
+    {
+    case JSON_KEY:
+        keyAt[depth] = keyFor(text);
+        break;
+
+    case JSON_TRUE:
+        if (depth == 1 && keyAt[1] == KEY_OK)
+            responseOk = true;
+        break;
+
+    case JSON_OBJECT_START:
+        keyAt[depth] = KEY_OTHER;
+        if (inUpdate && depth == 3)
+        {
+            current.chatId = 0;
+            current.text[0] = '\0';
+        }
+        break;
+
+    case JSON_NUMBER:
+        if (inUpdate && depth == 3 && keyAt[3] == KEY_UPDATE_ID)
+        {
+            int64_t id = strtoll(text, nullptr, 10);
+            if (id >= nextOffset)
+                nextOffset = id + 1;
+        }
+        else if (inUpdate && depth == 5 && keyAt[3] == KEY_MESSAGE && keyAt[4] == KEY_CHAT && keyAt[5] == KEY_ID)
+        {
+            current.chatId = strtoll(text, nullptr, 10);
+        }
+        break;
+
+    case JSON_STRING:
+        if (inUpdate && depth == 4 && keyAt[3] == KEY_MESSAGE && keyAt[4] == KEY_TEXT)
+            strlcpy(current.text, text, sizeof(current.text));
+        break;
+
+    case JSON_OBJECT_END:
+        if (depth == 1)
+            responseComplete = true;
+        if (inUpdate && depth == 3 && current.text[0] == '/' && pendingCount < BOT_MAX_PENDING)
+            pending[pendingCount++] = current;
+        break;
+
+    default:
+        break;
+    }
+}
+
+static JsonStream parser(onToken, nullptr);
+
+static String urlEncode(const String &text)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    String out;
+    out.reserve(text.length() * 3);
+    for (size_t i = 0; i < text.length(); i++)
+    {
+        char c = text[i];
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+        {
+            out += c;
+        }
+        else
+        {
+            out += '%';
+            out += hex[(uint8_t)c >> 4];
+            out += hex[c & 0x0F];
+        }
+    }
+    return out;
+}
+
+// Runs one Bot API call and streams the JSON body straight from the socket
+// through the tokenizer. Returns true if Telegram answered "ok":true.
+static bool callApi(const String &method)
+{
+    parser.reset();
+    memset(keyAt, 0, sizeof(keyAt));
+    responseOk = false;
+    responseComplete = false;
+
+    if (!http.begin(client, apiBase + method))
+        return false;
+
+    int code = http.GET();
+    if (code > 0)
+        http.writeToStream(&parser); // handles both Content-Length and chunked bodies
+    http.end();
+
+    uint32_t minHeap = ESP.getMinFreeHeap();
+    if (stats.minFreeHeap == 0 || minHeap < stats.minFreeHeap)
+        stats.minFreeHeap = minHeap;
+
+    if (code != HTTP_CODE_OK)
+    {
+        Serial.print("Telegram error code: ");
+        Serial.println(code);
+    }
+    return code == HTTP_CODE_OK && responseOk && responseComplete && !parser.failed();
+}
+
+static void dispatch(const PendingUpdate &update)
+{
+    if (update.chatId != allowedChatId)
+    {
+        Serial.println("Ignoring command from unknown chat");
+        return;
+    }
+
+    unsigned long start = millis();
+
+    // "/cmd@BotName args" -> name "/cmd", args "args"
+    const char *text = update.text;
+    size_t nameLen = strcspn(text, " @");
+    const char *args = text + strcspn(text, " ");
+    while (*args == ' ')
+        args++;
+
+    String reply;
+    bool found = false;
+    for (uint8_t i = 0; i < commandCount; i++)
+    {
+        if (strlen(commands[i].name) == nameLen && strncmp(commands[i].name, text, nameLen) == 0)
+        {
+            commands[i].handler(args, reply);
+            found = true;
+            break;
+        }
+    }
+    if (!found)
+        reply = "Unknown command: " + String(text).substring(0, nameLen);
+
+    Serial.println("Command: " + String(text));
+    if (reply.length())
+        botSendMessage(reply);
+
+    stats.commands++;
+    stats.lastCommandMs = millis() - start;
+    if (stats.lastCommandMs > stats.maxCommandMs)
+        stats.maxCommandMs = stats.lastCommandMs;
+}
+
+static void IRAM_ATTR countTick()
+{
+    ticks++;
+    if (xTaskGetCurrentTaskHandleForCPU(loopCore) == idleTask)
+        idleTicks++;
+}
+
+void botBegin(const String &token, const String &chatId)
+{
+    apiBase = "https://api.telegram.org/bot" + token;
+    chatIdParam = chatId;
+    allowedChatId = strtoll(chatId.c_str(), nullptr, 10);
+
+    client.setInsecure(); // This skips certificate validation, quick and works.
+    http.setReuse(true);
+    http.setTimeout(BOT_HTTP_TIMEOUT);
+
+    if (!idleTask)
+    {
+        loopCore = xPortGetCoreID();
+        idleTask = xTaskGetIdleTaskHandleForCPU(loopCore);
+        if (esp_register_freertos_tick_hook_for_cpu(countTick, loopCore) != ESP_OK)
+            Serial.println("No tick hook slot, CPU idle is not measured");
+    }
+}
+
+bool botOnCommand(const char *command, CommandHandler handler)
+{
+    if (commandCount >= BOT_MAX_COMMANDS)
+        return false;
+    commands[commandCount++] = {command, handler};
+    return true;
+}
+
+// One long-poll round trip: blocks until Telegram has updates or the poll
+// times out, then runs the handlers for every command received.
+void botPoll()
+{
+    char offset[24];
+    snprintf(offset, sizeof(offset), "%lld", (long long)nextOffset);
+
+    String method = "/getUpdates?timeout=" + String(BOT_POLL_TIMEOUT) +
+                    "&limit=" + String(BOT_MAX_PENDING) +
+                    "&allowed_updates=%5B%22message%22%5D&offset=" + offset;
+
+    int64_t offsetBefore = nextOffset;
+    pendingCount = 0;
+    collectUpdates = true;
+    stats.polls++;
+    unsigned long start = millis();
+    bool ok = callApi(method);
+    stats.pollMs += millis() - start;
+    collectUpdates = false;
+
+    if (!ok)
+    {
+        // Nothing from a failed poll is run, so let Telegram deliver it again
+        nextOffset = offsetBefore;
+        stats.pollErrors++;
+        delay(BOT_RETRY_DELAY);
+        return;
+    }
+
+    // Replies go over the same connection, which is fine now the body is drained
+    uint8_t count = pendingCount;
+    for (uint8_t i = 0; i < count; i++)
+        dispatch(pending[i]);
+}
+
+// Tell Telegram everything up to nextOffset is handled, without waiting for
+// the next long-poll. Needed before a reboot or the command would be redelivered.
+void botConfirmUpdates()
+{
+    char offset[24];
+    snprintf(offset, sizeof(offset), "%lld", (long long)nextOffset);
+    callApi(String("/getUpdates?timeout=0&limit=1&offset=") + offset);
+}
+
+bool botSendMessage(const String &text)
+{
+    return callApi("/sendMessage?chat_id=" + chatIdParam + "&text=" + urlEncode(text));
+}
+
+const BotStats &botStats()
+{
+    stats.ticks = ticks;
+    stats.idleTicks = idleTicks;
+    return stats;
+}
@@ -0,0 +1,124 @@
+// Host stand-in for the parts of the ESP32 Arduino core the bot uses
+#ifndef STUB_ARDUINO_H
+#define STUB_ARDUINO_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define IRAM_ATTR
+
+inline unsigned long fakeMillis = 0;
+inline unsigned long millis() { return fakeMillis; }
+
+// One FreeRTOS tick per simulated millisecond on the loop's core. Tests say
+// which task was running; delay() blocks the loop task, so the idle task runs.
+typedef void *TaskHandle_t;
+inline char fakeIdleTask, fakeLoopTask;
+inline TaskHandle_t fakeCurrentTask = &fakeLoopTask;
+inline void (*fakeTickHook)() = nullptr;
+
+inline void fakeRun(unsigned long ms, TaskHandle_t task)
+{
+    TaskHandle_t was = fakeCurrentTask;
+    fakeCurrentTask = task;
+    while (ms--)
+    {
+        fakeMillis++;
+        if (fakeTickHook)
+            fakeTickHook();
+    }
+    fakeCurrentTask = was;
+}
+
+inline void delay(unsigned long ms) { fakeRun(ms, &fakeIdleTask); }
+
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+class String
+{
+public:
+    String() {}
+    String(const char *s) : s_(s ? s : "") {}
+    String(const std::string &s) : s_(s) {}
+    String(char c) : s_(1, c) {}
+    String(int v) : s_(std::to_string(v)) {}
+    String(unsigned v) : s_(std::to_string(v)) {}
+    String(long v) : s_(std::to_string(v)) {}
+    String(unsigned long v) : s_(std::to_string(v)) {}
+    String(long long v) : s_(std::to_string(v)) {}
+    String(unsigned long long v) : s_(std::to_string(v)) {}
+    String(double v, unsigned decimals = 2)
+    {
+        char buf[40];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        s_ = buf;
+    }
+
+    size_t length() const { return s_.length(); }
+    const char *c_str() const { return s_.c_str(); }
+    char operator[](size_t i) const { return i < s_.length() ? s_[i] : 0; }
+    void reserve(size_t n) { s_.reserve(n); }
+    String substring(size_t from, size_t to) const { return from < s_.length() ? String(s_.substr(from, to - from)) : String(); }
+
+    String &operator+=(const String &o) { s_ += o.s_; return *this; }
+    String &operator+=(const char *o) { s_ += o; return *this; }
+    String &operator+=(char c) { s_ += c; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+    friend String operator+(const String &a, const char *b) { return String(a.s_ + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.s_); }
+    bool operator==(const char *o) const { return s_ == o; }
+
+private:
+    std::string s_;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len)
+    {
+        size_t n = 0;
+        while (len--)
+            n += write(*buf++);
+        return n;
+    }
+};
+
+struct SerialStub
+{
+    template <typename T> void print(const T &) {}
+    template <typename T> void println(const T &) {}
+};
+inline SerialStub Serial;
+
+// Heap in use and its peak, kept by a test that replaces operator new.
+// Stubs bump fakeHeapPaused around their own allocations so only the code
+// under test is counted.
+inline size_t fakeHeapUsed = 0, fakeHeapPeak = 0;
+inline int fakeHeapPaused = 0;
+
+struct EspStub
+{
+    uint32_t heapSize = 200000;
+    uint32_t getFreeHeap() { return heapSize - fakeHeapUsed; }
+    uint32_t getMinFreeHeap() { return heapSize - fakeHeapPeak; }
+};
+inline EspStub ESP;
+
+#endif
@@ -0,0 +1,49 @@
+// Host stand-in for HTTPClient: every request is answered by a test hook
+#ifndef STUB_HTTPCLIENT_H
+#define STUB_HTTPCLIENT_H
+
+#include <WiFi.h>
+
+#define HTTP_CODE_OK 200
+
+struct FakeResponse
+{
+    int code;
+    std::string body;
+};
+
+inline FakeResponse (*fakeHttpGet)(const std::string &url) = nullptr;
+
+class HTTPClient
+{
+public:
+    void setReuse(bool) {}
+    void setTimeout(uint16_t) {}
+    bool begin(WiFiClient &, const String &url)
+    {
+        url_ = url.c_str();
+        return true;
+    }
+    int GET()
+    {
+        fakeHeapPaused++;
+        FakeResponse r = fakeHttpGet ? fakeHttpGet(url_) : FakeResponse{-1, ""};
+        body_ = r.body;
+        fakeHeapPaused--;
+        return r.code;
+    }
+    // Fed in small pieces like TCP segments would arrive
+    int writeToStream(Print *stream)
+    {
+        for (size_t i = 0; i < body_.size(); i += 7)
+            stream->write((const uint8_t *)body_.data() + i, std::min<size_t>(7, body_.size() - i));
+        return body_.size();
+    }
+    void end() {}
+
+private:
+    std::string url_;
+    std::string body_;
+};
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef STUB_WIFI_H
+#define STUB_WIFI_H
+
+#include <Arduino.h>
+
+class WiFiClient
+{
+};
+
+#endif
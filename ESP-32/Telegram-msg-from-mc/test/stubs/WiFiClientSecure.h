@@ -0,0 +1,12 @@
+#ifndef STUB_WIFICLIENTSECURE_H
+#define STUB_WIFICLIENTSECURE_H
+
+#include <WiFi.h>
+
+class WiFiClientSecure : public WiFiClient
+{
+public:
+    void setInsecure() {}
+};
+
+#endif
@@ -0,0 +1,18 @@
+// Host stand-in for the FreeRTOS hook registration: the tick hook is called by
+// fakeRun() once per simulated millisecond
+#ifndef STUB_ESP_FREERTOS_HOOKS_H
+#define STUB_ESP_FREERTOS_HOOKS_H
+
+#include <freertos/task.h>
+
+typedef int esp_err_t;
+typedef void (*esp_freertos_tick_cb_t)();
+#define ESP_OK 0
+
+inline esp_err_t esp_register_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t cb, UBaseType_t)
+{
+    fakeTickHook = cb;
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,15 @@
+// Host stand-in for the FreeRTOS task queries the bot uses, the tasks
+// themselves are simulated in Arduino.h
+#ifndef STUB_FREERTOS_TASK_H
+#define STUB_FREERTOS_TASK_H
+
+#include <Arduino.h>
+
+typedef unsigned int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+inline BaseType_t xPortGetCoreID() { return 1; }
+inline TaskHandle_t xTaskGetCurrentTaskHandleForCPU(BaseType_t) { return fakeCurrentTask; }
+inline TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t) { return &fakeIdleTask; }
+
+#endif
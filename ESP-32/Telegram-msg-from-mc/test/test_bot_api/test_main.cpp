@@ -0,0 +1,367 @@
+// Runs the bot against a mock Bot API: queued getUpdates bodies go in, the
+// requested URLs and the dispatched commands come out. One case models the
+// time each call spends on the CPU and on the network and reports the bot's
+// heap peak, per-command latency and CPU idle fraction.
+//
+//   pio test -e native -f test_bot_api -v
+
+#include <deque>
+#include <new>
+#include <unity.h>
+#include <vector>
+
+#include "../../src/json_stream.cpp"
+#include "../../src/telegram_bot.cpp"
+
+#define TEST_CHAT "123456"
+#define OTHER_CHAT "999"
+
+// Timing model for the measured case: TLS records and parsing on the CPU,
+// then a round trip to api.telegram.org with the loop task blocked
+#define API_CPU_MS 12
+#define API_RTT_MS 90
+#define HANDLER_CPU_MS 3
+
+static std::deque<FakeResponse> updates; // Answers to getUpdates, in order
+static std::deque<unsigned long> holds;  // How long Telegram holds each of them, if modelled
+static std::vector<std::string> requests;
+static std::vector<std::string> sent; // Decoded sendMessage texts
+static std::vector<std::string> ran;  // "name|args" per handler call
+static bool modelTime = false;
+
+// Heap use of the code under test, stubs and the mock pause the count
+static bool trackHeap = false;
+static size_t pollPeak; // fakeHeapPeak is the lifetime peak behind getMinFreeHeap()
+
+struct alignas(16) AllocHeader
+{
+    size_t size;
+    bool counted;
+};
+
+void *operator new(size_t size)
+{
+    AllocHeader *h = (AllocHeader *)malloc(sizeof(AllocHeader) + size);
+    if (!h)
+        throw std::bad_alloc();
+    h->size = size;
+    h->counted = trackHeap && !fakeHeapPaused;
+    if (h->counted)
+    {
+        fakeHeapUsed += size;
+        if (fakeHeapUsed > fakeHeapPeak)
+            fakeHeapPeak = fakeHeapUsed;
+        if (fakeHeapUsed > pollPeak)
+            pollPeak = fakeHeapUsed;
+    }
+    return h + 1;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p)
+        return;
+    AllocHeader *h = (AllocHeader *)p - 1;
+    if (h->counted)
+        fakeHeapUsed -= h->size;
+    free(h);
+}
+
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
+static std::string urlDecode(const std::string &s)
+{
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '%' && i + 2 < s.size())
+        {
+            out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        }
+        else
+        {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+static FakeResponse mockApi(const std::string &url)
+{
+    requests.push_back(url);
+    if (modelTime)
+    {
+        if (url.find("/getUpdates?timeout=50") != std::string::npos && !holds.empty())
+        {
+            fakeRun(holds.front(), &fakeIdleTask);
+            holds.pop_front();
+        }
+        fakeRun(API_RTT_MS, &fakeIdleTask);
+        fakeRun(API_CPU_MS, &fakeLoopTask);
+    }
+    if (url.find("/sendMessage?") != std::string::npos)
+    {
+        sent.push_back(urlDecode(url.substr(url.find("&text=") + 6)));
+        return {HTTP_CODE_OK, "{\"ok\":true,\"result\":{\"message_id\":1}}"};
+    }
+    if (updates.empty() || url.find("timeout=0") != std::string::npos)
+        return {HTTP_CODE_OK, "{\"ok\":true,\"result\":[]}"};
+    FakeResponse r = updates.front();
+    updates.pop_front();
+    return r;
+}
+
+static std::string update(int64_t id, const char *chat, const char *text)
+{
+    return "{\"update_id\":" + std::to_string(id) + ",\"message\":{\"message_id\":7,\"from\":{\"id\":5,\"is_bot\":false," +
+           "\"first_name\":\"A\"},\"chat\":{\"id\":" + chat + ",\"type\":\"private\"},\"date\":1700000000,\"text\":\"" +
+           text + "\"}}";
+}
+
+static void queueUpdates(const std::vector<std::string> &items)
+{
+    std::string body = "{\"ok\":true,\"result\":[";
+    for (size_t i = 0; i < items.size(); i++)
+        body += (i ? "," : "") + items[i];
+    updates.push_back({HTTP_CODE_OK, body + "]}"});
+}
+
+static void record(const char *name, const char *args)
+{
+    fakeHeapPaused++;
+    ran.push_back(std::string(name) + "|" + args);
+    fakeHeapPaused--;
+}
+
+static void onStatus(const char *args, String &reply)
+{
+    record("/status", args);
+    if (modelTime)
+        fakeRun(HANDLER_CPU_MS, &fakeLoopTask);
+    reply = "Uptime: 1 h & 5 % \"ok\"";
+}
+
+static void onSilent(const char *args, String &)
+{
+    record("/silent", args);
+}
+
+void setUp()
+{
+    modelTime = false;
+    holds.clear();
+    updates.clear();
+    requests.clear();
+    sent.clear();
+    ran.clear();
+    nextOffset = 0;
+    stats = BotStats();
+    fakeHttpGet = mockApi;
+}
+
+void tearDown() {}
+
+static bool lastRequestHas(const char *part)
+{
+    return !requests.empty() && requests.back().find(part) != std::string::npos;
+}
+
+void test_dispatches_commands_with_args()
+{
+    queueUpdates({update(100, TEST_CHAT, "/status"), update(101, TEST_CHAT, "/silent  on  now")});
+    botPoll();
+
+    TEST_ASSERT_EQUAL(2, ran.size());
+    TEST_ASSERT_EQUAL_STRING("/status|", ran[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("/silent|on  now", ran[1].c_str());
+    TEST_ASSERT_EQUAL(2, stats.commands);
+    TEST_ASSERT_EQUAL(0, stats.pollErrors);
+
+    // Only /status replied, the reply survives URL encoding
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL_STRING("Uptime: 1 h & 5 % \"ok\"", sent[0].c_str());
+    TEST_ASSERT_TRUE(requests[1].find("chat_id=" TEST_CHAT "&") != std::string::npos);
+}
+
+void test_offset_advances_past_last_update()
+{
+    TEST_ASSERT_EQUAL(0, nextOffset);
+    queueUpdates({update(500, TEST_CHAT, "/silent"), update(502, TEST_CHAT, "not a command")});
+    botPoll();
+    TEST_ASSERT_TRUE(requests[0].find("/getUpdates?timeout=50&limit=4&") != std::string::npos);
+    TEST_ASSERT_TRUE(lastRequestHas("offset=0"));
+
+    botPoll();
+    TEST_ASSERT_TRUE(lastRequestHas("offset=503"));
+    TEST_ASSERT_EQUAL(1, ran.size()); // Plain text is not a command
+}
+
+void test_ignores_other_chats()
+{
+    queueUpdates({update(10, OTHER_CHAT, "/status"), update(11, TEST_CHAT, "/silent x")});
+    botPoll();
+
+    TEST_ASSERT_EQUAL(1, ran.size());
+    TEST_ASSERT_EQUAL_STRING("/silent|x", ran[0].c_str());
+    TEST_ASSERT_EQUAL(0, sent.size());
+    TEST_ASSERT_EQUAL(12, nextOffset); // Still consumed so it is not redelivered
+}
+
+void test_strips_bot_name_from_group_commands()
+{
+    queueUpdates({update(20, TEST_CHAT, "/silent@MyEspBot off")});
+    botPoll();
+
+    TEST_ASSERT_EQUAL(1, ran.size());
+    TEST_ASSERT_EQUAL_STRING("/silent|off", ran[0].c_str());
+}
+
+void test_unknown_command_gets_reply()
+{
+    queueUpdates({update(30, TEST_CHAT, "/reboot@MyEspBot now")});
+    botPoll();
+
+    TEST_ASSERT_EQUAL(0, ran.size());
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL_STRING("Unknown command: /reboot", sent[0].c_str());
+}
+
+void test_error_response_counts_without_dispatch()
+{
+    updates.push_back({502, "<html>Bad Gateway</html>"});
+    updates.push_back({HTTP_CODE_OK, "{\"ok\":false,\"error_code\":409,\"description\":\"Conflict\"}"});
+    updates.push_back({HTTP_CODE_OK, "{\"ok\":true,\"result\":[" + update(40, TEST_CHAT, "/status") + ",{\"upd"});
+    unsigned long before = millis();
+    botPoll();
+    botPoll();
+    botPoll();
+
+    TEST_ASSERT_EQUAL(3, stats.polls);
+    TEST_ASSERT_EQUAL(3, stats.pollErrors);
+    TEST_ASSERT_EQUAL(0, ran.size());
+    TEST_ASSERT_EQUAL(0, sent.size());
+    TEST_ASSERT_TRUE(lastRequestHas("offset=0")); // The cut-off update is fetched again
+    TEST_ASSERT_EQUAL(0, nextOffset);
+    TEST_ASSERT_EQUAL(3 * BOT_RETRY_DELAY, millis() - before); // Backs off after each failure
+}
+
+void test_confirm_updates_sends_offset_without_waiting()
+{
+    queueUpdates({update(77, TEST_CHAT, "/silent")});
+    botPoll();
+    botConfirmUpdates();
+
+    TEST_ASSERT_TRUE(lastRequestHas("/getUpdates?timeout=0&limit=1&offset=78"));
+    TEST_ASSERT_EQUAL(1, ran.size());
+}
+
+void test_long_text_is_truncated_not_overflowed()
+{
+    std::string longArgs(300, 'a');
+    queueUpdates({update(90, TEST_CHAT, ("/silent " + longArgs).c_str())});
+    botPoll();
+
+    TEST_ASSERT_EQUAL(1, ran.size());
+    TEST_ASSERT_EQUAL(strlen("/silent|") + JSON_STREAM_MAX_TOKEN - strlen("/silent "), ran[0].size());
+}
+
+struct PollResult
+{
+    size_t heapPeak; // Bytes above what was in use before the poll
+    unsigned long ms;
+};
+
+static PollResult measuredPoll()
+{
+    pollPeak = fakeHeapUsed;
+    size_t before = fakeHeapUsed;
+    unsigned long start = millis();
+    trackHeap = true;
+    botPoll();
+    trackHeap = false;
+    return {pollPeak - before, millis() - start};
+}
+
+// A day-like mix: commands that arrive while a poll is held, and polls that
+// time out with nothing. Every call costs API_CPU_MS + API_RTT_MS.
+void test_reports_heap_latency_and_idle()
+{
+    modelTime = true;
+    BotStats before = botStats();
+    unsigned long start = millis();
+    unsigned long busyMs = 0;
+    size_t peakSmall = 0, peakLarge = 0;
+    char msg[160];
+
+    // Telegram gives the bot a first name and other fields it never looks at
+    std::string padding = "\"entities\":[" + std::string(16000, ' ') + "],";
+    for (int i = 0; i < 20; i++)
+    {
+        bool empty = i % 4 == 3;
+        holds.push_back(empty ? BOT_POLL_TIMEOUT * 1000 : 2000 + i * 1500);
+        if (empty)
+            queueUpdates({});
+        else if (i % 2)
+            updates.push_back({HTTP_CODE_OK, "{\"ok\":true,\"result\":[" +
+                                                 update(1000 + i, TEST_CHAT, "/status").insert(1, padding) + "]}"});
+        else
+            queueUpdates({update(1000 + i, TEST_CHAT, "/status")});
+
+        PollResult r = measuredPoll();
+        busyMs += API_CPU_MS + (empty ? 0 : HANDLER_CPU_MS + API_CPU_MS);
+
+        if (empty)
+            continue;
+        // Handler plus the sendMessage call for the reply
+        TEST_ASSERT_EQUAL(HANDLER_CPU_MS + API_CPU_MS + API_RTT_MS, botStats().lastCommandMs);
+        if (i % 2)
+            peakLarge = std::max(peakLarge, r.heapPeak);
+        else
+            peakSmall = std::max(peakSmall, r.heapPeak);
+    }
+
+    const BotStats &after = botStats();
+    uint32_t ticks = after.ticks - before.ticks;
+    uint32_t idle = after.idleTicks - before.idleTicks;
+    double idlePct = 100.0 * idle / ticks;
+    double modelPct = 100.0 * (millis() - start - busyMs) / (millis() - start);
+
+    snprintf(msg, sizeof(msg), "%u commands, latency %u ms each (max %u ms), model %d ms CPU + %d ms RTT per call",
+             (unsigned)(after.commands - before.commands), (unsigned)after.lastCommandMs, (unsigned)after.maxCommandMs,
+             API_CPU_MS, API_RTT_MS);
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "heap peak per poll %u B (small body), %u B (16 KB body), min free %u of %u",
+             (unsigned)peakSmall, (unsigned)peakLarge, (unsigned)after.minFreeHeap, (unsigned)ESP.heapSize);
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "CPU idle %.2f %% over %u ticks (model %.2f %%)", idlePct, (unsigned)ticks, modelPct);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(millis() - start, ticks);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, modelPct, idlePct);
+    TEST_ASSERT_GREATER_THAN(95.0, idlePct);
+
+    // The body is tokenized as it arrives, so a bigger body needs no more heap
+    TEST_ASSERT_LESS_THAN(2048, peakLarge);
+    TEST_ASSERT_LESS_OR_EQUAL(peakSmall + 64, peakLarge);
+    TEST_ASSERT_LESS_OR_EQUAL(ESP.heapSize - peakLarge, after.minFreeHeap);
+}
+
+int main(int argc, char **argv)
+{
+    botBegin("TOKEN", TEST_CHAT);
+    botOnCommand("/status", onStatus);
+    botOnCommand("/silent", onSilent);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_dispatches_commands_with_args);
+    RUN_TEST(test_offset_advances_past_last_update);
+    RUN_TEST(test_ignores_other_chats);
+    RUN_TEST(test_strips_bot_name_from_group_commands);
+    RUN_TEST(test_unknown_command_gets_reply);
+    RUN_TEST(test_error_response_counts_without_dispatch);
+    RUN_TEST(test_confirm_updates_sends_offset_without_waiting);
+    RUN_TEST(test_long_text_is_truncated_not_overflowed);
+    RUN_TEST(test_reports_heap_latency_and_idle);
+    return UNITY_END();
+}
@@ -0,0 +1,28 @@
+#ifndef FLEET_CONTROL_H
+#define FLEET_CONTROL_H
+
+#include <Arduino.h>
+
+// Per-car identity, override with build flags (-DCAR_ID=3 -DCAR_GROUP=1)
+#ifndef CAR_ID
+#define CAR_ID 1 // 1..127
+#endif
+#ifndef CAR_GROUP
+#define CAR_GROUP 0 // 0..126
+#endif
+
+#define FLEET_PORT 4210
+#define FLEET_GROUP_IP IPAddress(239, 0, 42, 10)
+
+// Command entry target: 0 = every car, 1..127 = car ID, 128 + n = group n
+#define FLEET_TARGET_ALL 0
+#define FLEET_TARGET_GROUP 128
+
+typedef void (*FleetCommandHandler)(const String &command);
+
+void fleetBegin(FleetCommandHandler handler);
+void handleFleet();
+void fleetCancel();
+String fleetStatusJson();
+
+#endif
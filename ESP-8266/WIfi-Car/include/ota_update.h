@@ -0,0 +1,11 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+
+bool startOtaUpdate(const String &baseUrl);
+void handleOtaUpdate();
+bool otaInProgress();
+String otaStatusJson();
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef SPEED_CONTROL_H
+#define SPEED_CONTROL_H
+
+#define SPEED_LOOP_HZ 20
+#define MAX_WHEEL_SPEED 400 // Encoder ticks/s at full duty on a charged battery
+
+void initSpeedControl();
+void setWheelTargets(int targetA, int targetB);
+void stopWheels();
+int wheelSpeedA();
+int wheelSpeedB();
+
+#endif
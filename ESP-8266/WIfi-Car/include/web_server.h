@@ -2,6 +2,9 @@
 #define WEB_SERVER_H
 
 void HTTP_handleRoot();
+void HTTP_handleOta();
+void HTTP_handleOtaStatus();
+void HTTP_handleFleetStatus();
 void handleNotFound();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include "fleet_control.h"
+
+// Fleet mode: a controller (tools/fleet_ctl.py) multicasts sync beacons and
+// command packets. Each car tracks the controller clock from the beacons and
+// runs its entry of a command packet when the controller clock reaches the
+// packet's apply-at time, so every car moves at once instead of one HTTP
+// request per car.
+//
+// Packets are little endian:
+//   header  u16 magic, u8 version, u8 type, u16 seq, u32 time (controller micros)
+//   SYNC    header only, seq = controller session (random per run, 0 = none), time = send time
+//   CMD     header + u8 count + count * {u8 target, char cmd[3]}, time = apply at
+
+#define FLEET_MAGIC 0xF1EE
+#define FLEET_VERSION 1
+#define FLEET_SYNC 1
+#define FLEET_CMD 2
+
+#define FLEET_HEADER_LEN 10
+#define FLEET_ENTRY_LEN 4
+#define FLEET_MAX_ENTRIES 32
+#define FLEET_MAX_PACKET (FLEET_HEADER_LEN + 1 + FLEET_MAX_ENTRIES * FLEET_ENTRY_LEN)
+
+#define SYNC_SAMPLES 8          // Beacons kept for the offset estimate
+#define SYNC_TIMEOUT 5000       // ms without a beacon before the clock is untrusted
+#define SYNC_RESET_US 100000    // A jump this big means the controller restarted...
+#define SYNC_RESET_AGREE 3      // ...when it is forwards, or this many beacons in a row agree on it
+#define MAX_LEAD_US 2000000     // Apply-at further ahead than this is rejected
+#define PENDING_SLOTS 4
+
+struct PendingCommand {
+    bool used;
+    uint32_t applyAt; // Local micros
+    char cmd[4];
+};
+
+static WiFiUDP udp;
+static FleetCommandHandler onCommand = nullptr;
+static PendingCommand pending[PENDING_SLOTS];
+
+// Each beacon gives (controller send time - local receive time), which is the
+// true offset minus that packet's delay. The largest sample in the window is
+// the one that was delayed least.
+static uint32_t offsetSamples[SYNC_SAMPLES];
+static uint8_t sampleHead = 0, sampleCount = 0;
+static uint32_t clockOffset = 0; // controller micros - local micros
+static unsigned long lastBeacon = 0;
+static uint16_t session = 0; // Session of the controller the offset belongs to
+
+// Samples far below the offset are usually beacons the AP or modem sleep held
+// back for a few hundred ms, not a new controller clock
+static uint32_t outlierSamples[SYNC_RESET_AGREE];
+static uint8_t outlierCount = 0;
+
+// Repeats share both seq and apply-at. A restarted controller can reuse a
+// seq, but not with the same apply-at, so the pair tells them apart.
+static bool haveCmd = false;
+static uint16_t lastCmdSeq = 0;
+static uint32_t lastCmdTime = 0;
+
+static uint32_t beacons = 0, outliers = 0, commands = 0, applied = 0, late = 0, unsynced = 0, dropped = 0;
+static int32_t lastLateness = 0, maxLateness = 0;
+
+static bool synced() {
+    return sampleCount > 0 && millis() - lastBeacon < SYNC_TIMEOUT;
+}
+
+static void addSample(uint32_t sample) {
+    offsetSamples[sampleHead] = sample;
+    sampleHead = (sampleHead + 1) % SYNC_SAMPLES;
+    if (sampleCount < SYNC_SAMPLES) sampleCount++;
+
+    // Wrap-safe max over the window
+    clockOffset = offsetSamples[(sampleHead + SYNC_SAMPLES - 1) % SYNC_SAMPLES];
+    for (uint8_t i = 0; i < sampleCount; i++) {
+        if ((int32_t)(offsetSamples[i] - clockOffset) > 0) clockOffset = offsetSamples[i];
+    }
+}
+
+static void onBeacon(uint16_t beaconSession, uint32_t controllerTime, uint32_t receivedAt) {
+    uint32_t sample = controllerTime - receivedAt;
+    int32_t jump = (int32_t)(sample - clockOffset);
+    beacons++;
+
+    if (beaconSession != session) {
+        // fleet_ctl.py restarted: its clock has nothing to do with the old one
+        session = beaconSession;
+        sampleCount = 0;
+    }
+
+    if (sampleCount > 0 && jump > SYNC_RESET_US) {
+        // A delay only ever lowers a sample, so the controller clock moved
+        sampleCount = 0;
+    } else if (sampleCount > 0 && jump < -SYNC_RESET_US) {
+        if (outlierCount > 0 && abs((int32_t)(sample - outlierSamples[outlierCount - 1])) > SYNC_RESET_US) outlierCount = 0;
+        outlierSamples[outlierCount++] = sample;
+        outliers++;
+        if (outlierCount < SYNC_RESET_AGREE) return;
+
+        // Agreeing beacons in a row: a controller without a session
+        // restarted with its clock behind the old one
+        sampleCount = 0;
+        for (uint8_t i = 0; i + 1 < SYNC_RESET_AGREE; i++) addSample(outlierSamples[i]);
+    }
+
+    outlierCount = 0;
+    addSample(sample);
+    lastBeacon = millis();
+}
+
+static void applyNow(const char *cmd) {
+    applied++;
+    if (onCommand) onCommand(String(cmd));
+}
+
+static void schedule(const char *cmd, uint32_t controllerApplyAt) {
+    if (!synced()) {
+        // Better to move late than to ignore a stop
+        unsynced++;
+        applyNow(cmd);
+        return;
+    }
+
+    uint32_t applyAt = controllerApplyAt - clockOffset;
+    int32_t lead = (int32_t)(applyAt - micros());
+    if (lead > MAX_LEAD_US) {
+        dropped++;
+        return;
+    }
+
+    for (PendingCommand &p : pending) {
+        if (!p.used) {
+            p.used = true;
+            p.applyAt = applyAt;
+            memcpy(p.cmd, cmd, sizeof(p.cmd));
+            return;
+        }
+    }
+    dropped++;
+}
+
+// Picks this car's entry: its own ID wins over its group, which wins over "all"
+static bool findEntry(const uint8_t *entries, uint8_t count, char *cmd) {
+    int best = -1, bestRank = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t target = entries[i * FLEET_ENTRY_LEN];
+        int rank = 0;
+        if (target == CAR_ID) rank = 3;
+        else if (target == FLEET_TARGET_GROUP + CAR_GROUP) rank = 2;
+        else if (target == FLEET_TARGET_ALL) rank = 1;
+        if (rank > bestRank) {
+            best = i;
+            bestRank = rank;
+        }
+    }
+    if (best < 0) return false;
+
+    memcpy(cmd, entries + best * FLEET_ENTRY_LEN + 1, 3);
+    cmd[3] = '\0';
+    return true;
+}
+
+static void handlePacket(const uint8_t *buf, int len, uint32_t receivedAt) {
+    if (len < FLEET_HEADER_LEN) return;
+
+    uint16_t magic, seq;
+    uint32_t time;
+    memcpy(&magic, buf, 2);
+    memcpy(&seq, buf + 4, 2);
+    memcpy(&time, buf + 6, 4);
+    if (magic != FLEET_MAGIC || buf[2] != FLEET_VERSION) return;
+
+    if (buf[3] == FLEET_SYNC) {
+        onBeacon(seq, time, receivedAt);
+        return;
+    }
+    if (buf[3] != FLEET_CMD || len < FLEET_HEADER_LEN + 1) return;
+
+    // The controller sends every command a few times against packet loss
+    if (haveCmd && seq == lastCmdSeq && time == lastCmdTime) return;
+    haveCmd = true;
+    lastCmdSeq = seq;
+    lastCmdTime = time;
+    commands++;
+
+    uint8_t count = buf[FLEET_HEADER_LEN];
+    if (count > FLEET_MAX_ENTRIES || len < FLEET_HEADER_LEN + 1 + count * FLEET_ENTRY_LEN) return;
+
+    char cmd[4];
+    if (findEntry(buf + FLEET_HEADER_LEN + 1, count, cmd)) schedule(cmd, time);
+}
+
+void fleetBegin(FleetCommandHandler handler) {
+    onCommand = handler;
+    IPAddress local = WiFi.getMode() == WIFI_AP ? WiFi.softAPIP() : WiFi.localIP();
+    udp.beginMulticast(local, FLEET_GROUP_IP, FLEET_PORT);
+    // Modem sleep holds multicast until the next DTIM beacon, often 100-300 ms
+    WiFi.setSleepMode(WIFI_NONE_SLEEP);
+    Serial.printf("Fleet: car %d group %d on port %d\n", CAR_ID, CAR_GROUP, FLEET_PORT);
+}
+
+void handleFleet() {
+    int len;
+    while ((len = udp.parsePacket()) > 0) {
+        uint32_t receivedAt = micros();
+        uint8_t buf[FLEET_MAX_PACKET];
+        int n = udp.read(buf, sizeof(buf));
+        if (n == len) handlePacket(buf, n, receivedAt);
+    }
+
+    // Several can be due at once after a slow loop; run them in apply-at
+    // order so the latest one is what the car ends up doing
+    for (;;) {
+        PendingCommand *next = nullptr;
+        for (PendingCommand &p : pending) {
+            if (p.used && (!next || (int32_t)(p.applyAt - next->applyAt) < 0)) next = &p;
+        }
+        if (!next) break;
+
+        int32_t lateness = (int32_t)(micros() - next->applyAt);
+        if (lateness < 0) break;
+
+        PendingCommand &p = *next;
+        p.used = false;
+        lastLateness = lateness;
+        if (lateness > maxLateness) maxLateness = lateness;
+        if (lateness > 1000) late++;
+        applyNow(p.cmd);
+    }
+}
+
+// Drops scheduled commands, e.g. when an OTA update takes over the car
+void fleetCancel() {
+    for (PendingCommand &p : pending) p.used = false;
+}
+
+String fleetStatusJson() {
+    String json = "{\"car\":" + String(CAR_ID);
+    json += ",\"group\":" + String(CAR_GROUP);
+    json += ",\"synced\":" + String(synced() ? "true" : "false");
+    json += ",\"offsetUs\":" + String(clockOffset);
+    json += ",\"beacons\":" + String(beacons);
+    json += ",\"beaconOutliers\":" + String(outliers);
+    json += ",\"commands\":" + String(commands);
+    json += ",\"applied\":" + String(applied);
+    json += ",\"late\":" + String(late);
+    json += ",\"unsynced\":" + String(unsynced);
+    json += ",\"dropped\":" + String(dropped);
+    json += ",\"lastLatenessUs\":" + String(lastLateness);
+    json += ",\"maxLatenessUs\":" + String(maxLateness);
+    json += "}";
+    return json;
+}
@@ -5,17 +5,41 @@
 #include "motor_control.h"
 #include "buzzer_led.h"
 #include "web_server.h"
+#include "ota_update.h"
+#include "fleet_control.h"
 
 int enA = D1, in1 = D2, in2 = D3, in3 = D4, in4 = D5, enB = D6;
 int buzPin = D7, ledPin = D8, wifiLedPin = D0;
+// Wheel encoders on RX (D9) and SD3. GPIO10 is a flash data line in QIO mode,
+// so the board must be flashed in DIO (board_build.flash_mode in platformio.ini).
+int encAPin = 3, encBPin = 10;
 
 ESP8266WebServer server(80);
-String command;
 String sta_ssid = "Trash Car", sta_password = "Trash8266";
 unsigned long previousMillis = 0;
 
+// Drive commands from the web page (/?State=) and from fleet packets
+void handleCommand(const String &command) {
+    // Motors stay stopped while a pulled update is flashing
+    if (otaInProgress()) return;
+
+    if (command == "e") Forward();
+    else if (command == "b") Backward();
+    else if (command == "r") TurnRight();
+    else if (command == "l") TurnLeft();
+    else if (command == "s") Stop();
+    else if (command == "fr") ForwardRight();
+    else if (command == "fl") ForwardLeft();
+    else if (command == "br") BackwardRight();
+    else if (command == "bl") BackwardLeft();
+    else if (command == "f1") BeepOn();
+    else if (command == "f0") BeepOff();
+    else if (command >= "0" && command <= "9") SPEED = map(command[0] - '0', 0, 9, 0, 1023);
+    else if (command == "q") SPEED = 1023;
+}
+
 void setup() {
-    Serial.begin(115200);
+    Serial.begin(115200, SERIAL_8N1, SERIAL_TX_ONLY); // RX pin is used by encoder A
     pinMode(wifiLedPin, OUTPUT);
     digitalWrite(wifiLedPin, HIGH);
 
@@ -50,27 +74,25 @@ void setup() {
     }
 
     server.on("/", HTTP_handleRoot);
+    server.on("/ota", HTTP_handleOta);
+    server.on("/ota/status", HTTP_handleOtaStatus);
+    server.on("/fleet/status", HTTP_handleFleetStatus);
     server.onNotFound(handleNotFound);
     server.begin();
+    ArduinoOTA.onStart([]() { Stop(); });
     ArduinoOTA.begin();
+    fleetBegin(handleCommand);
 }
 
 void loop() {
     ArduinoOTA.handle();
     server.handleClient();
 
-    command = server.arg("State");
-    if (command == "e") Forward();
-    else if (command == "b") Backward();
-    else if (command == "r") TurnRight();
-    else if (command == "l") TurnLeft();
-    else if (command == "s") Stop();
-    else if (command == "fr") ForwardRight();
-    else if (command == "fl") ForwardLeft();
-    else if (command == "br") BackwardRight();
-    else if (command == "bl") BackwardLeft();
-    else if (command == "f1") BeepOn();
-    else if (command == "f0") BeepOff();
-    else if (command >= "0" && command <= "9") SPEED = map(command[0] - '0', 0, 9, 0, 1023);
-    else if (command == "q") SPEED = 1023;
+    if (otaInProgress()) {
+        fleetCancel();
+        handleOtaUpdate();
+        return;
+    }
+
+    handleFleet();
 }
\ No newline at end of file
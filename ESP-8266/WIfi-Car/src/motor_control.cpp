@@ -1,10 +1,16 @@
 #include <Arduino.h>
 #include "motor_control.h"
+#include "speed_control.h"
 
 extern int enA, enB, in1, in2, in3, in4;
 int SPEED = 1023;
 int speed_Coeff = 3;
 
+// SPEED (0-1023) is a fraction of the top wheel speed, not a raw duty
+static int targetSpeed() {
+    return (long)SPEED * MAX_WHEEL_SPEED / 1023;
+}
+
 void initMotors() {
     pinMode(enA, OUTPUT);
     pinMode(enB, OUTPUT);
@@ -12,68 +18,60 @@ void initMotors() {
     pinMode(in2, OUTPUT);
     pinMode(in3, OUTPUT);
     pinMode(in4, OUTPUT);
+    initSpeedControl();
     Stop();
 }
 
 void Forward() {
-    analogWrite(enA, SPEED);
-    analogWrite(enB, SPEED);
+    setWheelTargets(targetSpeed(), targetSpeed());
     digitalWrite(in1, HIGH); digitalWrite(in2, LOW);
     digitalWrite(in3, HIGH); digitalWrite(in4, LOW);
 }
 
 void Backward() {
-    analogWrite(enA, SPEED);
-    analogWrite(enB, SPEED);
+    setWheelTargets(targetSpeed(), targetSpeed());
     digitalWrite(in1, LOW); digitalWrite(in2, HIGH);
     digitalWrite(in3, LOW); digitalWrite(in4, HIGH);
 }
 
 void TurnRight() {
-    analogWrite(enA, SPEED);
-    analogWrite(enB, SPEED);
+    setWheelTargets(targetSpeed(), targetSpeed());
     digitalWrite(in1, LOW); digitalWrite(in2, HIGH);
     digitalWrite(in3, HIGH); digitalWrite(in4, LOW);
 }
 
 void TurnLeft() {
-    analogWrite(enA, SPEED);
-    analogWrite(enB, SPEED);
+    setWheelTargets(targetSpeed(), targetSpeed());
     digitalWrite(in1, HIGH); digitalWrite(in2, LOW);
     digitalWrite(in3, LOW); digitalWrite(in4, HIGH);
 }
 
 void ForwardRight() {
-    analogWrite(enA, SPEED / speed_Coeff);
-    analogWrite(enB, SPEED);
+    setWheelTargets(targetSpeed() / speed_Coeff, targetSpeed());
     digitalWrite(in1, HIGH); digitalWrite(in2, LOW);
     digitalWrite(in3, HIGH); digitalWrite(in4, LOW);
 }
 
 void ForwardLeft() {
-    analogWrite(enA, SPEED);
-    analogWrite(enB, SPEED / speed_Coeff);
+    setWheelTargets(targetSpeed(), targetSpeed() / speed_Coeff);
     digitalWrite(in1, HIGH); digitalWrite(in2, LOW);
     digitalWrite(in3, HIGH); digitalWrite(in4, LOW);
 }
 
 void BackwardRight() {
-    analogWrite(enA, SPEED / speed_Coeff);
-    analogWrite(enB, SPEED);
+    setWheelTargets(targetSpeed() / speed_Coeff, targetSpeed());
     digitalWrite(in1, LOW); digitalWrite(in2, HIGH);
     digitalWrite(in3, LOW); digitalWrite(in4, HIGH);
 }
 
 void BackwardLeft() {
-    analogWrite(enA, SPEED);
-    analogWrite(enB, SPEED / speed_Coeff);
+    setWheelTargets(targetSpeed(), targetSpeed() / speed_Coeff);
     digitalWrite(in1, LOW); digitalWrite(in2, HIGH);
     digitalWrite(in3, LOW); digitalWrite(in4, HIGH);
 }
 
 void Stop() {
-    analogWrite(enA, 0);
-    analogWrite(enB, 0);
+    stopWheels();
     digitalWrite(in1, LOW); digitalWrite(in2, LOW);
     digitalWrite(in3, LOW); digitalWrite(in4, LOW);
 }
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include <Arduino.h>
+#include <new>
+#include <ESP8266WiFi.h>
+#include <ESP8266HTTPClient.h>
+#include <Updater.h>
+#include "ota_update.h"
+#include "motor_control.h"
+
+// Pull-based OTA: the car streams a gzip image (built by tools/ota_pack.py) in
+// one GET, checks each chunk's CRC before it touches flash, and after a drop or
+// a bad chunk asks for the rest with a Range request from the last good chunk.
+// A server that ignores Range answers 200 and the car reads past what it has.
+// eboot inflates the image on reboot.
+
+#define OTA_MAX_CHUNK 4096
+#define OTA_MAX_CHUNKS 512
+#define OTA_HTTP_TIMEOUT 5000
+#define OTA_RETRY_MIN 500
+#define OTA_RETRY_MAX 8000
+#define OTA_MAX_RETRIES 40
+
+enum OtaState { OTA_IDLE, OTA_RUNNING, OTA_DONE, OTA_FAILED };
+
+static OtaState otaState = OTA_IDLE;
+static String otaBaseUrl;
+static String otaError;
+static uint32_t imageSize = 0;
+static uint32_t chunkSize = 0;
+static uint16_t chunkCount = 0;
+static uint16_t nextChunk = 0;
+static uint32_t *chunkCrc = nullptr;
+static uint8_t *chunkBuf = nullptr; // Only allocated while an update runs
+
+static WiFiClient otaClient;
+static HTTPClient otaHttp;
+static WiFiClient *otaStream = nullptr; // Open image response, positioned at nextChunk
+
+static uint16_t retries = 0;
+static uint32_t retryDelay = OTA_RETRY_MIN;
+static unsigned long retryAt = 0;
+static unsigned long startedAt = 0;
+static unsigned long finishedAt = 0;
+static uint32_t bytesTransferred = 0; // includes chunks that failed and were fetched again
+
+// Same polynomial as zlib.crc32 on the host side
+static uint32_t crc32(const uint8_t *data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (length--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void releaseBuffers() {
+    delete[] chunkCrc;
+    chunkCrc = nullptr;
+    delete[] chunkBuf;
+    chunkBuf = nullptr;
+}
+
+static void closeStream() {
+    if (otaStream) otaHttp.end();
+    otaStream = nullptr;
+}
+
+static void failOta(const String &reason) {
+    Serial.println("OTA failed: " + reason);
+    otaError = reason;
+    otaState = OTA_FAILED;
+    finishedAt = millis();
+    // Without evenIfRemaining the Updater just resets, no flush or MD5 pass
+    if (Update.isRunning()) Update.end();
+    closeStream();
+    releaseBuffers();
+}
+
+// Manifest format, one entry per line:
+//   size <bytes>
+//   chunk <bytes>
+//   md5 <hex>
+//   crc <hex>   (repeated once per chunk, in order)
+static bool parseManifest(const String &manifest, String &md5) {
+    imageSize = 0;
+    chunkSize = 0;
+    chunkCount = 0;
+    uint16_t crcIndex = 0;
+
+    int lineStart = 0;
+    while (lineStart < (int)manifest.length()) {
+        int lineEnd = manifest.indexOf('\n', lineStart);
+        if (lineEnd < 0) lineEnd = manifest.length();
+        String line = manifest.substring(lineStart, lineEnd);
+        line.trim();
+        lineStart = lineEnd + 1;
+
+        if (line.startsWith("size ")) {
+            imageSize = line.substring(5).toInt();
+        } else if (line.startsWith("chunk ")) {
+            chunkSize = line.substring(6).toInt();
+            if (chunkCrc || chunkSize == 0 || chunkSize > OTA_MAX_CHUNK) return false;
+            chunkCount = (imageSize + chunkSize - 1) / chunkSize;
+            if (chunkCount == 0 || chunkCount > OTA_MAX_CHUNKS) return false;
+            chunkCrc = new uint32_t[chunkCount];
+        } else if (line.startsWith("md5 ")) {
+            md5 = line.substring(4);
+        } else if (line.startsWith("crc ")) {
+            if (!chunkCrc || crcIndex >= chunkCount) return false;
+            chunkCrc[crcIndex++] = strtoul(line.c_str() + 4, nullptr, 16);
+        }
+    }
+    return chunkCrc && crcIndex == chunkCount && md5.length() == 32;
+}
+
+bool startOtaUpdate(const String &baseUrl) {
+    if (otaState == OTA_RUNNING) return false;
+
+    // Never leave the wheels turning while the main loop is busy flashing
+    Stop();
+
+    closeStream();
+    releaseBuffers();
+    otaBaseUrl = baseUrl;
+    otaError = "";
+    nextChunk = 0;
+    retries = 0;
+    retryDelay = OTA_RETRY_MIN;
+    bytesTransferred = 0;
+    startedAt = millis();
+    finishedAt = 0;
+    otaState = OTA_RUNNING;
+
+    WiFiClient client;
+    HTTPClient http;
+    http.setTimeout(OTA_HTTP_TIMEOUT);
+    http.begin(client, otaBaseUrl + "/manifest");
+    int code = http.GET();
+    if (code != HTTP_CODE_OK) {
+        http.end();
+        failOta("manifest HTTP " + String(code));
+        return false;
+    }
+    String manifest = http.getString();
+    http.end();
+    bytesTransferred += manifest.length();
+
+    String md5;
+    if (!parseManifest(manifest, md5)) {
+        failOta("bad manifest");
+        return false;
+    }
+
+    chunkBuf = new (std::nothrow) uint8_t[chunkSize];
+    if (!chunkBuf) {
+        failOta("no heap for a " + String(chunkSize) + " byte chunk");
+        return false;
+    }
+
+    if (!Update.begin(imageSize) || !Update.setMD5(md5.c_str())) {
+        failOta("no room for " + String(imageSize) + " bytes");
+        return false;
+    }
+
+    Serial.printf("OTA: %u bytes in %u chunks from %s\n", imageSize, chunkCount, otaBaseUrl.c_str());
+    retryAt = millis();
+    return true;
+}
+
+// Requests the image from the start of nextChunk
+static bool openStream() {
+    uint32_t offset = (uint32_t)nextChunk * chunkSize;
+    otaHttp.setTimeout(OTA_HTTP_TIMEOUT);
+    otaHttp.begin(otaClient, otaBaseUrl + "/image");
+    if (offset) otaHttp.addHeader("Range", "bytes=" + String(offset) + "-");
+    int code = otaHttp.GET();
+    int size = otaHttp.getSize();
+
+    uint32_t skip;
+    if (code == HTTP_CODE_PARTIAL_CONTENT && size == (int)(imageSize - offset)) {
+        skip = 0;
+    } else if (code == HTTP_CODE_OK && size == (int)imageSize) {
+        skip = offset;
+    } else {
+        otaHttp.end();
+        return false;
+    }
+
+    otaStream = otaHttp.getStreamPtr();
+    otaStream->setTimeout(OTA_HTTP_TIMEOUT);
+    while (skip) {
+        size_t want = min(skip, chunkSize);
+        size_t got = otaStream->readBytes(chunkBuf, want);
+        bytesTransferred += got;
+        if (got != want) {
+            closeStream();
+            return false;
+        }
+        skip -= got;
+    }
+    return true;
+}
+
+static bool readChunk(size_t expected) {
+    size_t got = otaStream->readBytes(chunkBuf, expected);
+    bytesTransferred += got;
+    return got == expected;
+}
+
+void handleOtaUpdate() {
+    if (otaState != OTA_RUNNING || (long)(millis() - retryAt) < 0) return;
+
+    size_t expected = (nextChunk == chunkCount - 1) ? imageSize - (uint32_t)nextChunk * chunkSize : chunkSize;
+    bool ok = WiFi.status() == WL_CONNECTED && (otaStream || openStream()) && readChunk(expected) &&
+              crc32(chunkBuf, expected) == chunkCrc[nextChunk];
+
+    if (!ok) {
+        // Resume from the same chunk once the link comes back
+        closeStream();
+        if (++retries > OTA_MAX_RETRIES) {
+            failOta("chunk " + String(nextChunk) + " kept failing");
+            return;
+        }
+        retryAt = millis() + retryDelay;
+        retryDelay = min(retryDelay * 2, (uint32_t)OTA_RETRY_MAX);
+        return;
+    }
+
+    if (Update.write(chunkBuf, expected) != expected) {
+        failOta("flash write error " + String(Update.getError()));
+        return;
+    }
+
+    retries = 0;
+    retryDelay = OTA_RETRY_MIN;
+    nextChunk++;
+
+    if (nextChunk < chunkCount) return;
+    closeStream();
+
+    if (!Update.end()) {
+        failOta("verify error " + String(Update.getError()));
+        return;
+    }
+
+    otaState = OTA_DONE;
+    finishedAt = millis();
+    releaseBuffers();
+    Serial.printf("OTA done: %u bytes transferred in %lu ms, rebooting\n", bytesTransferred, finishedAt - startedAt);
+    delay(500);
+    ESP.restart();
+}
+
+bool otaInProgress() {
+    return otaState == OTA_RUNNING;
+}
+
+String otaStatusJson() {
+    static const char *names[] = {"idle", "running", "done", "failed"};
+    unsigned long elapsed = otaState == OTA_IDLE ? 0 : (finishedAt ? finishedAt : millis()) - startedAt;
+
+    String json = "{\"state\":\"";
+    json += names[otaState];
+    json += "\",\"chunk\":" + String(nextChunk);
+    json += ",\"chunks\":" + String(chunkCount);
+    json += ",\"bytes\":" + String(bytesTransferred);
+    json += ",\"ms\":" + String(elapsed);
+    if (otaError.length()) json += ",\"error\":\"" + otaError + "\"";
+    json += "}";
+    return json;
+}
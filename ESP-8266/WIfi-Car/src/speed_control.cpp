@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include <Ticker.h>
+#include "speed_control.h"
+
+// Closed-loop wheel speed: encoder ticks are counted in IRAM interrupts and a
+// fixed-rate PID per wheel turns target speeds (ticks/s) into PWM duty.
+// The loop runs from a Ticker because timer1 already drives analogWrite.
+
+// Gains are Q8 fixed point (256 = 1.0), duty per tick/s of error
+#define SPEED_KP 384
+#define SPEED_KI 2048 // Per second, scaled by the measured period each tick
+#define SPEED_KD 32   // Per nominal period
+#define SPEED_PERIOD_US (1000000L / SPEED_LOOP_HZ)
+#define MAX_INTEGRATE_US (4 * SPEED_PERIOD_US) // A late tick integrates at most this much
+#define MIN_MEASURE_US (SPEED_PERIOD_US / 2)    // Shorter windows are too coarse, wait for the next tick
+#define SPEED_KFF (1023L * 256 / MAX_WHEEL_SPEED) // Open-loop duty for a given target
+#define INTEGRAL_LIMIT 512                         // Max duty the integrator may add or remove
+#define MAX_DUTY 1023
+
+extern int enA, enB, encAPin, encBPin;
+
+struct WheelLoop {
+    int pwmPin;
+    int target;   // ticks/s
+    int measured; // ticks/s
+    int lastError;
+    long integral; // Q8 duty
+    uint32_t lastTicks;
+};
+
+static volatile uint32_t ticksA = 0, ticksB = 0;
+static WheelLoop wheelA = {}, wheelB = {};
+static Ticker speedTicker;
+static uint32_t lastLoopMicros = 0;
+
+static void IRAM_ATTR onEncoderA() { ticksA++; }
+static void IRAM_ATTR onEncoderB() { ticksB++; }
+
+// dt is the measured time since the last update: the Ticker runs from the
+// SDK's timer task and fires late whenever WiFi holds the CPU.
+static void updateWheel(WheelLoop &w, uint32_t ticks, uint32_t dt) {
+    w.measured = (uint64_t)(ticks - w.lastTicks) * 1000000 / dt;
+    w.lastTicks = ticks;
+
+    if (w.target == 0) {
+        w.integral = 0;
+        w.lastError = 0;
+        analogWrite(w.pwmPin, 0);
+        return;
+    }
+
+    int error = w.target - w.measured;
+    long ff = (long)w.target * SPEED_KFF;
+    long p = (long)error * SPEED_KP;
+    long d = (int64_t)(error - w.lastError) * SPEED_KD * SPEED_PERIOD_US / dt;
+    w.lastError = error;
+
+    // Anti-windup: stop integrating while the output is pinned and the error
+    // would push it further into saturation
+    long out = (ff + p + w.integral + d) >> 8;
+    bool saturatedHigh = out >= MAX_DUTY && error > 0;
+    bool saturatedLow = out <= 0 && error < 0;
+    if (!saturatedHigh && !saturatedLow) {
+        w.integral += (int64_t)error * SPEED_KI * min(dt, (uint32_t)MAX_INTEGRATE_US) / 1000000;
+        w.integral = constrain(w.integral, -((long)INTEGRAL_LIMIT << 8), (long)INTEGRAL_LIMIT << 8);
+        out = (ff + p + w.integral + d) >> 8;
+    }
+
+    analogWrite(w.pwmPin, constrain(out, 0, MAX_DUTY));
+}
+
+static void speedLoop() {
+    uint32_t now = micros();
+    uint32_t dt = now - lastLoopMicros;
+    if (dt < MIN_MEASURE_US) return; // Bunched up behind a late one
+    lastLoopMicros = now;
+
+    updateWheel(wheelA, ticksA, dt);
+    updateWheel(wheelB, ticksB, dt);
+}
+
+void initSpeedControl() {
+    wheelA.pwmPin = enA;
+    wheelB.pwmPin = enB;
+
+    pinMode(encAPin, INPUT_PULLUP);
+    pinMode(encBPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(encAPin), onEncoderA, RISING);
+    attachInterrupt(digitalPinToInterrupt(encBPin), onEncoderB, RISING);
+
+    lastLoopMicros = micros();
+    speedTicker.attach_ms(1000 / SPEED_LOOP_HZ, speedLoop);
+}
+
+// Targets are wheel speeds in ticks/s; direction is set by the H-bridge pins
+void setWheelTargets(int targetA, int targetB) {
+    wheelA.target = constrain(targetA, 0, MAX_WHEEL_SPEED);
+    wheelB.target = constrain(targetB, 0, MAX_WHEEL_SPEED);
+}
+
+// Cut both wheels now instead of waiting for the next loop tick
+void stopWheels() {
+    setWheelTargets(0, 0);
+    wheelA.integral = wheelB.integral = 0;
+    analogWrite(enA, 0);
+    analogWrite(enB, 0);
+}
+
+int wheelSpeedA() { return wheelA.measured; }
+int wheelSpeedB() { return wheelB.measured; }
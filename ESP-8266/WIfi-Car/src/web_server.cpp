@@ -1,15 +1,37 @@
 #include <ESP8266WebServer.h>
 #include "web_server.h"
+#include "ota_update.h"
+#include "fleet_control.h"
 
 extern ESP8266WebServer server;
+extern void handleCommand(const String &command);
 
 void HTTP_handleRoot() {
     server.send(200, "text/html", " ");
     if (server.hasArg("State")) {
         Serial.println(server.arg("State"));
+        handleCommand(server.arg("State"));
     }
 }
 
+// /ota?url=http://host:8000/car-fw starts a pull from a tools/ota_pack.py output dir
+void HTTP_handleOta() {
+    if (!server.hasArg("url")) {
+        server.send(400, "text/plain", "missing url");
+        return;
+    }
+    startOtaUpdate(server.arg("url"));
+    server.send(200, "application/json", otaStatusJson());
+}
+
+void HTTP_handleOtaStatus() {
+    server.send(200, "application/json", otaStatusJson());
+}
+
+void HTTP_handleFleetStatus() {
+    server.send(200, "application/json", fleetStatusJson());
+}
+
 void handleNotFound() {
     server.send(404, "text/plain", "404: Not Found");
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+// Host stand-in for the parts of the ESP8266 Arduino core the car code uses.
+// Time is simulated: tests move fakeMicros forward, delay() advances it.
+
+#ifndef STUB_ARDUINO_H
+#define STUB_ARDUINO_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+inline uint32_t fakeMicros = 0;
+// Boot time of this board before fakeMicros, for tests that run several
+// boards. 64 bits so millis() runs on when micros() wraps, as on the board.
+inline uint64_t fakeClockSkew = 0;
+inline uint32_t micros() { return fakeMicros + fakeClockSkew; }
+inline unsigned long millis() { return (fakeMicros + fakeClockSkew) / 1000; }
+inline void delay(unsigned long ms) { fakeMicros += ms * 1000; }
+inline void yield() {}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// Pins: the last value written is kept so tests can read duty and direction
+inline int pinValue[32];
+inline void (*pinInterrupt[32])() = {};
+inline void pinMode(int, int) {}
+inline void digitalWrite(int pin, int value) { pinValue[pin & 31] = value; }
+inline void analogWrite(int pin, int value) { pinValue[pin & 31] = value; }
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(int pin, void (*isr)(), int) { pinInterrupt[pin & 31] = isr; }
+
+class String {
+public:
+    String() {}
+    String(const char *s) : s_(s ? s : "") {}
+    String(const std::string &s) : s_(s) {}
+    String(char c) : s_(1, c) {}
+    String(int v) : s_(std::to_string(v)) {}
+    String(unsigned v) : s_(std::to_string(v)) {}
+    String(long v) : s_(std::to_string(v)) {}
+    String(unsigned long v) : s_(std::to_string(v)) {}
+    String(double v, unsigned decimals = 2) {
+        char buf[40];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        s_ = buf;
+    }
+
+    unsigned length() const { return s_.length(); }
+    const char *c_str() const { return s_.c_str(); }
+    char operator[](unsigned i) const { return i < s_.length() ? s_[i] : 0; }
+    void reserve(unsigned n) { s_.reserve(n); }
+
+    String &operator+=(const String &o) { s_ += o.s_; return *this; }
+    String &operator+=(const char *o) { s_ += o; return *this; }
+    String &operator+=(char c) { s_ += c; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+    friend String operator+(const String &a, const char *b) { return String(a.s_ + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.s_); }
+
+    bool operator==(const String &o) const { return s_ == o.s_; }
+    bool operator==(const char *o) const { return s_ == o; }
+    bool operator!=(const String &o) const { return s_ != o.s_; }
+    bool operator!=(const char *o) const { return s_ != o; }
+    bool operator<(const char *o) const { return s_ < o; }
+    bool operator>(const char *o) const { return s_ > o; }
+    bool operator<=(const char *o) const { return s_ <= o; }
+    bool operator>=(const char *o) const { return s_ >= o; }
+
+    int indexOf(char c, unsigned from = 0) const {
+        size_t i = s_.find(c, from);
+        return i == std::string::npos ? -1 : (int)i;
+    }
+    int indexOf(const char *str, unsigned from = 0) const {
+        size_t i = s_.find(str, from);
+        return i == std::string::npos ? -1 : (int)i;
+    }
+    String substring(unsigned from) const { return from < s_.length() ? String(s_.substr(from)) : String(); }
+    String substring(unsigned from, unsigned to) const {
+        if (from > to) std::swap(from, to);
+        return from < s_.length() ? String(s_.substr(from, to - from)) : String();
+    }
+    bool startsWith(const char *prefix) const { return s_.compare(0, strlen(prefix), prefix) == 0; }
+    void trim() {
+        size_t a = s_.find_first_not_of(" \t\r\n");
+        size_t b = s_.find_last_not_of(" \t\r\n");
+        s_ = a == std::string::npos ? "" : s_.substr(a, b - a + 1);
+    }
+    long toInt() const { return atol(s_.c_str()); }
+    float toFloat() const { return atof(s_.c_str()); }
+
+private:
+    std::string s_;
+};
+
+class Stream {
+public:
+    void setTimeout(unsigned long) {}
+};
+
+struct SerialStub {
+    template <typename... Args> void printf(const char *, Args...) {}
+    template <typename T> void print(const T &) {}
+    template <typename T> void println(const T &) {}
+    void println() {}
+};
+inline SerialStub Serial;
+
+struct EspStub {
+    int restarts = 0;
+    void restart() { restarts++; }
+    uint32_t getFreeHeap() { return 40000; }
+};
+inline EspStub ESP;
+
+#endif
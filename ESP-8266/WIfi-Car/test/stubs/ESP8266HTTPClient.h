@@ -0,0 +1,51 @@
+// Host stand-in for ESP8266HTTPClient: every GET is answered by a test hook,
+// which also sees the request headers
+#ifndef STUB_ESP8266HTTPCLIENT_H
+#define STUB_ESP8266HTTPCLIENT_H
+
+#include <ESP8266WiFi.h>
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTPC_ERROR_CONNECTION_REFUSED -1
+
+struct FakeResponse {
+    int code;
+    size_t contentLength; // What the header announces
+    std::string body;     // What the server sends, see fakeStreamRead for pacing
+};
+
+inline FakeResponse (*fakeHttpGet)(const std::string &url, const std::string &headers) = nullptr;
+
+class HTTPClient {
+public:
+    void setTimeout(uint16_t) {}
+    bool begin(WiFiClient &client, const String &url) {
+        client_ = &client;
+        url_ = url.c_str();
+        headers_.clear();
+        return true;
+    }
+    void addHeader(const String &name, const String &value) {
+        headers_ += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+    }
+    int GET() {
+        FakeResponse r = fakeHttpGet ? fakeHttpGet(url_, headers_) : FakeResponse{HTTPC_ERROR_CONNECTION_REFUSED, 0, ""};
+        size_ = r.code == HTTP_CODE_OK || r.code == HTTP_CODE_PARTIAL_CONTENT ? (int)r.contentLength : -1;
+        fakeStreamData = r.body;
+        fakeStreamPos = 0;
+        return r.code;
+    }
+    int getSize() { return size_; }
+    String getString() { return String(fakeStreamData); }
+    WiFiClient *getStreamPtr() { return client_; }
+    void end() {}
+
+private:
+    WiFiClient *client_ = nullptr;
+    std::string url_;
+    std::string headers_;
+    int size_ = -1;
+};
+
+#endif
@@ -0,0 +1,54 @@
+// Host stand-in for ESP8266WiFi: link state comes from a test hook
+#ifndef STUB_ESP8266WIFI_H
+#define STUB_ESP8266WIFI_H
+
+#include <Arduino.h>
+
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+#define WIFI_STA 1
+#define WIFI_AP 2
+
+enum WiFiSleepType { WIFI_NONE_SLEEP = 0, WIFI_LIGHT_SLEEP = 1, WIFI_MODEM_SLEEP = 2 };
+
+struct IPAddress {
+    uint8_t octets[4] = {0, 0, 0, 0};
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+};
+
+inline bool (*fakeLinkUp)() = nullptr;
+
+struct WiFiStub {
+    int status() { return !fakeLinkUp || fakeLinkUp() ? WL_CONNECTED : WL_DISCONNECTED; }
+    int getMode() { return WIFI_STA; }
+    IPAddress localIP() { return IPAddress(192, 168, 1, 10); }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    bool setSleepMode(WiFiSleepType type) {
+        sleepMode = type;
+        return true;
+    }
+    WiFiSleepType sleepMode = WIFI_MODEM_SLEEP; // SDK default in STA mode
+};
+inline WiFiStub WiFi;
+
+// Body of the response being read, set by HTTPClient::GET()
+inline std::string fakeStreamData;
+inline size_t fakeStreamPos = 0;
+
+// How many of len bytes arrive before the read times out, lets tests move the
+// clock at link speed and drop the link mid-body. All of them if unset.
+inline size_t (*fakeStreamRead)(size_t len) = nullptr;
+
+class WiFiClient : public Stream {
+public:
+    size_t readBytes(uint8_t *buf, size_t len) {
+        size_t n = std::min(len, fakeStreamData.size() - fakeStreamPos);
+        if (fakeStreamRead) n = std::min(n, fakeStreamRead(n));
+        memcpy(buf, fakeStreamData.data() + fakeStreamPos, n);
+        fakeStreamPos += n;
+        return n;
+    }
+};
+
+#endif
@@ -0,0 +1,22 @@
+// Host stand-in for Ticker: nothing runs on its own, tests call the callback
+// at whatever times they want to model.
+#ifndef STUB_TICKER_H
+#define STUB_TICKER_H
+
+#include <Arduino.h>
+
+class Ticker {
+public:
+    typedef void (*callback_t)();
+
+    void attach_ms(uint32_t ms, callback_t cb) {
+        periodMs = ms;
+        callback = cb;
+    }
+    void detach() { callback = nullptr; }
+
+    uint32_t periodMs = 0;
+    callback_t callback = nullptr;
+};
+
+#endif
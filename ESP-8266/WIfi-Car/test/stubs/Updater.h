@@ -0,0 +1,39 @@
+// Host stand-in for the ESP8266 Updater: keeps the written image in memory
+#ifndef STUB_UPDATER_H
+#define STUB_UPDATER_H
+
+#include <Arduino.h>
+#include <vector>
+
+struct UpdaterStub {
+    std::vector<uint8_t> image;
+    size_t size = 0;
+    bool running = false;
+    bool committed = false;
+    int partialFlushes = 0; // end(true) on an unfinished image
+
+    bool begin(size_t len) {
+        image.clear();
+        size = len;
+        running = true;
+        committed = false;
+        return true;
+    }
+    bool setMD5(const char *md5) { return strlen(md5) == 32; }
+    size_t write(const uint8_t *data, size_t len) {
+        image.insert(image.end(), data, data + len);
+        return len;
+    }
+    bool end(bool evenIfRemaining = false) {
+        bool finished = image.size() == size;
+        if (!finished && evenIfRemaining) partialFlushes++;
+        running = false;
+        committed = finished;
+        return finished;
+    }
+    bool isRunning() { return running; }
+    uint8_t getError() { return 0; }
+};
+inline UpdaterStub Update;
+
+#endif
@@ -0,0 +1,85 @@
+// Host stand-in for WiFiUDP multicast: every socket that joined a group gets
+// its own copy of each packet sent to it, after a delay picked by a test hook.
+// Delivery times are in fakeMicros, the shared time, not a board's own clock.
+#ifndef STUB_WIFIUDP_H
+#define STUB_WIFIUDP_H
+
+#include <deque>
+#include <vector>
+#include <ESP8266WiFi.h>
+
+struct FakeDatagram {
+    uint32_t deliverAt;
+    std::vector<uint8_t> data;
+};
+
+struct FakeMember {
+    uint16_t port;
+    uint8_t group[4];
+    std::deque<FakeDatagram> inbox;
+};
+
+inline std::vector<FakeMember> fakeMembers;
+
+// Delay in us for one packet to one member, or -1 to lose it
+inline int32_t (*fakeNetDelay)(int member) = nullptr;
+
+class WiFiUDP {
+public:
+    uint8_t beginMulticast(IPAddress, IPAddress group, uint16_t port) {
+        member_ = (int)fakeMembers.size();
+        fakeMembers.push_back(FakeMember{port, {group.octets[0], group.octets[1], group.octets[2], group.octets[3]}, {}});
+        return 1;
+    }
+
+    int beginPacketMulticast(IPAddress group, uint16_t port, IPAddress, int = 1) {
+        out_.clear();
+        outPort_ = port;
+        memcpy(outGroup_, group.octets, 4);
+        return 1;
+    }
+    size_t write(const uint8_t *buf, size_t len) {
+        out_.insert(out_.end(), buf, buf + len);
+        return len;
+    }
+    int endPacket() {
+        for (size_t i = 0; i < fakeMembers.size(); i++) {
+            FakeMember &m = fakeMembers[i];
+            if (m.port != outPort_ || memcmp(m.group, outGroup_, 4)) continue;
+            int32_t delay = fakeNetDelay ? fakeNetDelay((int)i) : 0;
+            if (delay >= 0) m.inbox.push_back(FakeDatagram{fakeMicros + delay, out_});
+        }
+        return 1;
+    }
+
+    // Earliest packet that has arrived; later sends can overtake earlier ones
+    int parsePacket() {
+        current_.clear();
+        if (member_ < 0) return 0;
+        std::deque<FakeDatagram> &inbox = fakeMembers[member_].inbox;
+        auto next = inbox.end();
+        for (auto it = inbox.begin(); it != inbox.end(); ++it) {
+            if ((int32_t)(fakeMicros - it->deliverAt) < 0) continue;
+            if (next == inbox.end() || (int32_t)(it->deliverAt - next->deliverAt) < 0) next = it;
+        }
+        if (next == inbox.end()) return 0;
+        current_ = next->data;
+        inbox.erase(next);
+        return (int)current_.size();
+    }
+    int read(uint8_t *buf, size_t len) {
+        size_t n = std::min(len, current_.size());
+        memcpy(buf, current_.data(), n);
+        current_.clear();
+        return (int)n;
+    }
+
+private:
+    int member_ = -1;
+    std::vector<uint8_t> out_;
+    uint16_t outPort_ = 0;
+    uint8_t outGroup_[4] = {};
+    std::vector<uint8_t> current_;
+};
+
+#endif
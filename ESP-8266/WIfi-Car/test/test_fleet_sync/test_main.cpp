@@ -0,0 +1,422 @@
+// Runs 2 to 50 cars against one controller over a simulated multicast
+// network. Each car has its own clock offset and crystal drift, packets take
+// 1-4 ms with the odd 10-30 ms WiFi stall and some are lost, and each car's
+// loop() comes round every 0.2-2 ms with a rare 20-60 ms block. Reports how
+// far apart the cars ran each command (skew) and how late they ran it against
+// the controller's apply-at time. Further cases hold single beacons back by
+// 120-300 ms, as modem sleep and DTIM buffering do, and restart the controller.
+//
+//   pio test -e native -f test_fleet_sync -v
+
+#include <unity.h>
+
+#include <algorithm>
+#include <vector>
+
+// One copy of the fleet code plays every car, so identity is a variable here
+static int carId = 1, carGroup = 0;
+#define CAR_ID carId
+#define CAR_GROUP carGroup
+
+#include "../../src/fleet_control.cpp"
+
+#define SIM_STEP_US 100
+#define CONTROLLER_START 0xFFB3B4C0u // Controller clock wraps 5 s in, each car's at a random point
+#define SYNC_SETTLE_US 2000000
+#define COMMAND_PERIOD_US 1000000
+#define COMMANDS 50
+#define BEACON_PERIOD_US 250000 // fleet_ctl.py --beacon
+#define LEAD_US 150000          // fleet_ctl.py --lead
+#define REPEATS 3
+#define REPEAT_GAP_US 10000
+#define MAX_DRIFT_PPM 50
+#define RUN_US (SYNC_SETTLE_US + COMMANDS * COMMAND_PERIOD_US + LEAD_US + 100000)
+
+// fleet_control.cpp state, swapped in while a car runs
+#define CAR_STATE(X)                                                                            \
+    X(udp) X(onCommand) X(pending) X(offsetSamples) X(sampleHead) X(sampleCount) X(clockOffset) \
+    X(lastBeacon) X(session) X(outlierSamples) X(outlierCount) X(haveCmd) X(lastCmdSeq)         \
+    X(lastCmdTime) X(beacons) X(outliers) X(commands) X(applied) X(late) X(unsynced) X(dropped) \
+    X(lastLateness) X(maxLateness)
+#define CAR_FIELD(name) decltype(::name) name{};
+#define CAR_SWAP(name) std::swap(::name, car.name);
+
+struct Run {
+    std::string cmd;
+    uint32_t at; // Shared time
+};
+
+struct Car {
+    int id;
+    int group;
+    uint64_t boot; // Local micros at fakeMicros 0
+    double ppm;
+    uint32_t nextLoop;
+    std::vector<Run> runs;
+    CAR_STATE(CAR_FIELD)
+};
+
+static std::vector<Car> cars;
+static Car *running = nullptr;
+static WiFiUDP controller;
+static uint16_t controllerSeq = 0;
+static uint16_t controllerSession = 0; // Sent in beacons, 0 like an older fleet_ctl.py
+static uint32_t controllerShift = 0;   // Clock change on a controller restart
+
+static uint32_t seed = 1;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi) {
+    seed = seed * 1103515245 + 12345;
+    return lo + (seed >> 8) % (hi - lo + 1);
+}
+
+static int32_t netDelay(int) {
+    uint32_t roll = rnd(0, 999);
+    if (roll < 20) return -1;
+    if (roll < 50) return rnd(10000, 30000);
+    return rnd(1000, 4000);
+}
+
+static uint32_t controllerClock() {
+    return CONTROLLER_START + controllerShift + fakeMicros;
+}
+
+// Every packet takes exactly this long, set per packet by the test
+static int32_t fixedDelay = 0;
+static int32_t fixedNetDelay(int) { return fixedDelay; }
+
+// Car's micros() minus fakeMicros
+static uint64_t skewOf(const Car &car) {
+    return car.boot + llround(fakeMicros * car.ppm * 1e-6);
+}
+
+static void enter(Car &car) {
+    fakeClockSkew = skewOf(car);
+    carId = car.id;
+    carGroup = car.group;
+    CAR_STATE(CAR_SWAP)
+    running = &car;
+}
+
+static void leave(Car &car) {
+    CAR_STATE(CAR_SWAP)
+    fakeClockSkew = 0;
+    running = nullptr;
+}
+
+static void onRun(const String &cmd) {
+    running->runs.push_back({cmd.c_str(), fakeMicros});
+}
+
+static void send(uint8_t type, uint16_t seq, uint32_t time, const std::vector<uint8_t> &payload = {}) {
+    uint8_t header[FLEET_HEADER_LEN];
+    uint16_t magic = FLEET_MAGIC;
+    memcpy(header, &magic, 2);
+    header[2] = FLEET_VERSION;
+    header[3] = type;
+    memcpy(header + 4, &seq, 2);
+    memcpy(header + 6, &time, 4);
+
+    controller.beginPacketMulticast(FLEET_GROUP_IP, FLEET_PORT, IPAddress());
+    controller.write(header, sizeof(header));
+    if (!payload.empty()) controller.write(payload.data(), payload.size());
+    controller.endPacket();
+}
+
+static void addEntry(std::vector<uint8_t> &payload, uint8_t target, const char *cmd) {
+    payload.push_back(target);
+    for (int i = 0; i < 3; i++) payload.push_back(cmd[i]);
+    payload[0]++;
+}
+
+// Every car gets "s", group 1 gets "f" and car 2 (also in group 1) gets "b",
+// each followed by the command number so the runs can be matched up
+static std::vector<uint8_t> commandPayload(int n) {
+    char cmd[8];
+    std::vector<uint8_t> payload(1, 0);
+    snprintf(cmd, sizeof(cmd), "s%02d", n);
+    addEntry(payload, FLEET_TARGET_ALL, cmd);
+    snprintf(cmd, sizeof(cmd), "f%02d", n);
+    addEntry(payload, FLEET_TARGET_GROUP + 1, cmd);
+    snprintf(cmd, sizeof(cmd), "b%02d", n);
+    addEntry(payload, 2, cmd);
+    return payload;
+}
+
+static char expectedLetter(const Car &car) {
+    return car.id == 2 ? 'b' : car.group == 1 ? 'f' : 's';
+}
+
+static void resetNetwork(int count) {
+    fakeMembers.clear();
+    fakeNetDelay = netDelay;
+    fakeMicros = 0;
+    fakeClockSkew = 0;
+    controller = WiFiUDP();
+    controllerSeq = rnd(0, 0xFFFF);
+    controllerSession = rnd(1, 0xFFFF);
+    controllerShift = 0;
+
+    cars.clear();
+    cars.resize(count);
+    for (int i = 0; i < count; i++) {
+        Car &car = cars[i];
+        car.id = i + 1;
+        car.group = i % 3;
+        car.boot = ((uint64_t)rnd(1, 3) << 32) - rnd(0, RUN_US);
+        car.ppm = (double)rnd(0, 2 * MAX_DRIFT_PPM * 10) / 10 - MAX_DRIFT_PPM;
+        car.nextLoop = fakeMicros + rnd(0, 2000);
+        enter(car);
+        fleetBegin(onRun);
+        leave(car);
+    }
+}
+
+static void runCars() {
+    for (Car &car : cars) {
+        if ((int32_t)(fakeMicros - car.nextLoop) < 0) continue;
+        enter(car);
+        handleFleet();
+        leave(car);
+        // Web server and motor work between fleet polls, now and then a long one
+        car.nextLoop = fakeMicros + rnd(200, 2000) + (rnd(0, 9999) == 0 ? rnd(20000, 60000) : 0);
+    }
+}
+
+struct Result {
+    int missed, wrong, repeated;
+    uint32_t skewMedian, skewMax;   // Spread between first and last car per command
+    uint32_t lateP95, lateMax;      // Car run time minus apply-at, over all runs
+};
+
+static Result simulate(int count) {
+    resetNetwork(count);
+
+    uint32_t applyAt[COMMANDS];
+    uint16_t seq = 0;
+    for (fakeMicros = 0; fakeMicros < RUN_US; fakeMicros += SIM_STEP_US) {
+        if (fakeMicros % BEACON_PERIOD_US == 0) send(FLEET_SYNC, controllerSession, controllerClock());
+
+        if (fakeMicros >= SYNC_SETTLE_US) {
+            uint32_t since = fakeMicros - SYNC_SETTLE_US;
+            uint32_t n = since / COMMAND_PERIOD_US, phase = since % COMMAND_PERIOD_US;
+            if (n < COMMANDS && phase < REPEATS * REPEAT_GAP_US && phase % REPEAT_GAP_US == 0) {
+                if (phase == 0) {
+                    seq = ++controllerSeq;
+                    applyAt[n] = controllerClock() + LEAD_US;
+                }
+                send(FLEET_CMD, seq, applyAt[n], commandPayload(n));
+            }
+        }
+
+        runCars();
+    }
+
+    Result r = {};
+    std::vector<uint32_t> skews, lateness;
+    for (int n = 0; n < COMMANDS; n++) {
+        uint32_t first = 0, last = 0;
+        bool any = false;
+        for (Car &car : cars) {
+            int found = 0;
+            for (const Run &run : car.runs) {
+                if (atoi(run.cmd.c_str() + 1) != n) continue;
+                if (found++) {
+                    r.repeated++;
+                    continue;
+                }
+                if (run.cmd[0] != expectedLetter(car)) r.wrong++;
+                lateness.push_back(CONTROLLER_START + run.at - applyAt[n]);
+                if (!any || (int32_t)(run.at - first) < 0) first = run.at;
+                if (!any || (int32_t)(run.at - last) > 0) last = run.at;
+                any = true;
+            }
+            if (!found) r.missed++;
+        }
+        skews.push_back(last - first);
+    }
+
+    std::sort(skews.begin(), skews.end());
+    std::sort(lateness.begin(), lateness.end());
+    r.skewMedian = skews[skews.size() / 2];
+    r.skewMax = skews.back();
+    r.lateP95 = lateness[lateness.size() * 95 / 100];
+    r.lateMax = lateness.back();
+    return r;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Needs two sync beacons through before a command goes out
+static void syncOneCar() {
+    resetNetwork(1);
+    fakeNetDelay = fixedNetDelay;
+    fixedDelay = 0;
+    for (int i = 0; i < 4; i++) {
+        send(FLEET_SYNC, controllerSession, controllerClock());
+        runCars();
+        fakeMicros += BEACON_PERIOD_US;
+    }
+}
+
+static void stepUntil(uint32_t until) {
+    while ((int32_t)(fakeMicros - until) < 0) {
+        fakeMicros += SIM_STEP_US;
+        runCars();
+    }
+}
+
+void test_skew_across_fleet_sizes(void) {
+    static const int sizes[] = {2, 5, 10, 25, 50};
+    for (int count : sizes) {
+        Result r = simulate(count);
+
+        char line[200];
+        snprintf(line, sizeof(line),
+                 "%2d cars: skew median %5.2f ms max %5.2f ms, lateness p95 %5.2f ms max %5.2f ms, missed %d wrong %d repeated %d",
+                 count, r.skewMedian / 1000.0, r.skewMax / 1000.0, r.lateP95 / 1000.0, r.lateMax / 1000.0,
+                 r.missed, r.wrong, r.repeated);
+        TEST_MESSAGE(line);
+
+        TEST_ASSERT_EQUAL(0, r.missed);
+        TEST_ASSERT_EQUAL(0, r.wrong);
+        TEST_ASSERT_EQUAL(0, r.repeated);
+        // One loop period between polls plus the least beacon delay
+        TEST_ASSERT_LESS_THAN(5000, r.skewMedian);
+        TEST_ASSERT_LESS_THAN(5000, r.lateP95);
+        // A car blocked in a long loop runs late, but never early or lost
+        TEST_ASSERT_LESS_THAN(70000, r.skewMax);
+        TEST_ASSERT_LESS_THAN(70000, r.lateMax);
+    }
+}
+
+// A restarted fleet_ctl.py can reuse the seq of the last command it sent
+void test_restarted_controller_reusing_seq(void) {
+    syncOneCar();
+    Car &car = cars[0];
+    std::vector<uint8_t> payload = commandPayload(1);
+
+    uint32_t applyAt = controllerClock() + LEAD_US;
+    for (int i = 0; i < REPEATS; i++) send(FLEET_CMD, 1, applyAt, payload);
+    stepUntil(fakeMicros + LEAD_US + 10000);
+    TEST_ASSERT_EQUAL(1, car.runs.size());
+
+    // Same seq from the new process, later apply-at
+    payload = commandPayload(2);
+    applyAt = controllerClock() + LEAD_US;
+    for (int i = 0; i < REPEATS; i++) send(FLEET_CMD, 1, applyAt, payload);
+    stepUntil(fakeMicros + LEAD_US + 10000);
+    TEST_ASSERT_EQUAL(2, car.runs.size());
+    TEST_ASSERT_EQUAL_STRING("s02", car.runs[1].cmd.c_str());
+}
+
+// Both commands are overdue when the car next polls; the later apply-at
+// must win however they landed in the pending slots
+void test_overdue_commands_run_in_apply_order(void) {
+    syncOneCar();
+    Car &car = cars[0];
+
+    uint32_t now = controllerClock();
+    send(FLEET_CMD, 10, now + 100000, commandPayload(1));
+    send(FLEET_CMD, 11, now + 50000, commandPayload(2));
+    fakeMicros += 200000;
+    runCars();
+
+    TEST_ASSERT_EQUAL(2, car.runs.size());
+    TEST_ASSERT_EQUAL_STRING("s02", car.runs[0].cmd.c_str());
+    TEST_ASSERT_EQUAL_STRING("s01", car.runs[1].cmd.c_str());
+}
+
+// Offset error of a car against the controller clock, both in micros
+static int32_t offsetError(const Car &car) {
+    return (int32_t)(car.clockOffset + (uint32_t)(fakeMicros + skewOf(car)) - controllerClock());
+}
+
+static void beaconWithDelay(uint32_t delay) {
+    fixedDelay = delay;
+    send(FLEET_SYNC, controllerSession, controllerClock());
+    fixedDelay = 0;
+}
+
+// Modem sleep or an AP buffering multicast until DTIM holds single beacons
+// back well past SYNC_RESET_US. The estimate must ride them out, and a
+// command sent right after one still runs on time.
+void test_delayed_beacons_keep_offset(void) {
+    static const uint32_t delays[] = {120000, 180000, 250000, 300000};
+    syncOneCar();
+    Car &car = cars[0];
+    int32_t worst = 0, worstLate = 0;
+    TEST_ASSERT_EQUAL(WIFI_NONE_SLEEP, WiFi.sleepMode); // Set by fleetBegin()
+
+    for (uint32_t delay : delays) {
+        // A late one, then two in a row, each followed by a command
+        for (int burst = 1; burst < SYNC_RESET_AGREE; burst++) {
+            for (int i = 0; i < burst; i++) {
+                beaconWithDelay(delay - i * 20000);
+                stepUntil(fakeMicros + BEACON_PERIOD_US);
+            }
+            stepUntil(fakeMicros + delay);
+            worst = std::max(worst, abs(offsetError(car)));
+
+            uint32_t applyAt = controllerClock() + LEAD_US;
+            size_t before = car.runs.size();
+            send(FLEET_CMD, ++controllerSeq, applyAt, commandPayload(before % 100));
+            stepUntil(fakeMicros + LEAD_US + 10000);
+            TEST_ASSERT_EQUAL(before + 1, car.runs.size());
+            worstLate = std::max(worstLate, abs((int32_t)(CONTROLLER_START + controllerShift + car.runs.back().at - applyAt)));
+
+            send(FLEET_SYNC, controllerSession, controllerClock());
+            stepUntil(fakeMicros + BEACON_PERIOD_US);
+        }
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "beacons held back 120-300 ms: %u outliers, offset off by %.2f ms, commands off by %.2f ms",
+             car.outliers, worst / 1000.0, worstLate / 1000.0);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(4 * (1 + 2), car.outliers);
+    TEST_ASSERT_LESS_THAN(1000, worst);
+    TEST_ASSERT_LESS_THAN(3000, worstLate);
+}
+
+static void restartController(uint16_t newSession, uint32_t shift) {
+    controllerSession = newSession;
+    controllerShift = shift;
+    send(FLEET_SYNC, controllerSession, controllerClock());
+    stepUntil(fakeMicros + BEACON_PERIOD_US);
+}
+
+// Without a session, a clock that moved forwards resets at once and one that
+// moved back after SYNC_RESET_AGREE agreeing beacons. A new session resets at
+// once whichever way the clock moved.
+void test_controller_restart_resets_offset(void) {
+    syncOneCar();
+    Car &car = cars[0];
+
+    restartController(0, 0);
+    TEST_ASSERT_LESS_THAN(1000, abs(offsetError(car)));
+    restartController(0, 3000000);
+    TEST_ASSERT_LESS_THAN(1000, abs(offsetError(car)));
+
+    for (int i = 0; i < SYNC_RESET_AGREE; i++) {
+        restartController(0, 0);
+        TEST_ASSERT_EQUAL(i + 1 < SYNC_RESET_AGREE, abs(offsetError(car)) > 1000000);
+    }
+    TEST_ASSERT_LESS_THAN(1000, abs(offsetError(car)));
+
+    restartController(0x1234, 2000000);
+    TEST_ASSERT_LESS_THAN(1000, abs(offsetError(car)));
+    restartController(0x4321, 0);
+    TEST_ASSERT_LESS_THAN(1000, abs(offsetError(car)));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_skew_across_fleet_sizes);
+    RUN_TEST(test_restarted_controller_reusing_seq);
+    RUN_TEST(test_overdue_commands_run_in_apply_order);
+    RUN_TEST(test_delayed_beacons_keep_offset);
+    RUN_TEST(test_controller_restart_resets_offset);
+    return UNITY_END();
+}
@@ -0,0 +1,339 @@
+// Replays interrupted OTA transfers against a simulated link and compares the
+// car's pull of a packed image with the current path: one stream of the raw
+// firmware that has to start over after every drop (what ArduinoOTA or a plain
+// HTTP update does).
+//
+// The firmware is synthetic but compresses like a real image (code patterns,
+// string tables, zero padding) and is packed the way tools/ota_pack.py does it:
+// gzip level 9, fixed-size chunks, one CRC per chunk.
+//
+//   pio test -e native -f test_ota_resume -v
+
+#include <unity.h>
+#include <vector>
+#include <zlib.h>
+
+#include "../../src/ota_update.cpp"
+
+void Stop() {}
+
+// Link model: 40 KB/s, 40 ms per request, drops with an outage after each
+#define LINK_BYTES_PER_MS 40
+#define LINK_REQUEST_MS 40
+#define LINK_CONNECT_FAIL_MS 1000
+#define FIRMWARE_SIZE (300 * 1024)
+#define TEST_CHUNK 4096 // ota_pack.py --chunk default
+
+struct Drop {
+    uint32_t at;     // ms
+    uint32_t outage; // ms
+};
+
+static std::vector<uint8_t> firmware; // firmware.bin
+static std::vector<uint8_t> image;    // Packed, what the car downloads
+static std::string manifest;
+static std::vector<Drop> drops;
+static std::vector<int> corruptOnce;
+static bool serveImage = true;
+static bool honourRange = true;
+static bool streamBroken = false;
+
+static uint32_t nowMs() { return fakeMicros / 1000; }
+static void advanceMs(uint32_t ms) { fakeMicros += ms * 1000; }
+
+static bool linkUpAt(uint32_t t) {
+    for (const Drop &d : drops) {
+        if (t >= d.at && t < d.at + d.outage) return false;
+    }
+    return true;
+}
+
+static bool linkUp() { return linkUpAt(nowMs()); }
+
+// First drop that starts inside (from, to), or 0
+static uint32_t dropBetween(uint32_t from, uint32_t to) {
+    for (const Drop &d : drops) {
+        if (d.at > from && d.at < to) return d.at;
+    }
+    return 0;
+}
+
+// Moves the clock through `len` bytes of body, returns the bytes that arrive
+// before a drop. After a drop the read waits out the stream timeout.
+static size_t receive(size_t len) {
+    if (streamBroken) {
+        advanceMs(OTA_HTTP_TIMEOUT);
+        return 0;
+    }
+    uint32_t end = fakeMicros + len * 1000 / LINK_BYTES_PER_MS;
+    uint32_t drop = dropBetween(nowMs(), end / 1000);
+    if (!drop) {
+        fakeMicros = end;
+        return len;
+    }
+    size_t got = (drop * 1000 - fakeMicros) * LINK_BYTES_PER_MS / 1000;
+    fakeMicros = (drop + OTA_HTTP_TIMEOUT) * 1000;
+    streamBroken = true;
+    return min(got, len);
+}
+
+static FakeResponse serve(const std::string &url, const std::string &headers) {
+    streamBroken = false;
+    if (!linkUp()) {
+        advanceMs(LINK_CONNECT_FAIL_MS);
+        return {HTTPC_ERROR_CONNECTION_REFUSED, 0, ""};
+    }
+    advanceMs(LINK_REQUEST_MS);
+
+    if (url.size() >= 9 && url.compare(url.size() - 9, 9, "/manifest") == 0) {
+        size_t got = receive(manifest.size());
+        return {HTTP_CODE_OK, manifest.size(), manifest.substr(0, got)};
+    }
+    if (!serveImage) return {404, 0, ""};
+
+    size_t offset = 0;
+    size_t range = headers.find("Range: bytes=");
+    if (honourRange && range != std::string::npos) offset = atol(headers.c_str() + range + 13);
+
+    std::string body((const char *)image.data(), image.size());
+    for (size_t i = 0; i < corruptOnce.size(); i++) {
+        size_t at = (size_t)corruptOnce[i] * TEST_CHUNK + TEST_CHUNK / 2;
+        if (at >= offset) {
+            body[at] ^= 0x55;
+            corruptOnce.erase(corruptOnce.begin() + i);
+            break;
+        }
+    }
+
+    if (offset) return {HTTP_CODE_PARTIAL_CONTENT, image.size() - offset, body.substr(offset)};
+    return {HTTP_CODE_OK, image.size(), body};
+}
+
+static uint32_t seed = 12345;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi) {
+    seed = seed * 1103515245 + 12345;
+    return lo + (seed >> 8) % (hi - lo + 1);
+}
+
+// Code from a small, skewed set of 3-byte instructions with varying operands,
+// string tables, lookup tables and zero padding between sections
+static void buildFirmware() {
+    static const char *words[] = {"WiFi", "connect", "failed", "error", "motor", "speed", "state", "/ota",
+                                  "status", "%s:%d", "HTTP/1.1", "Content-Type", "application/json",
+                                  "text/html", "\"state\":", "chunk", "update", "heap", "timeout", "ESP8266"};
+    uint8_t ops[256][3];
+    for (auto &op : ops) {
+        for (uint8_t &b : op) b = rnd(0, 255);
+    }
+
+    firmware.clear();
+    while (firmware.size() < FIRMWARE_SIZE) {
+        uint32_t kind = rnd(0, 99);
+        uint32_t len = 0;
+        if (kind < 70) {
+            for (len = rnd(512, 4096); len > 0; len--) {
+                uint32_t r = rnd(0, 255);
+                const uint8_t *op = ops[r * r / 256];
+                firmware.insert(firmware.end(), op, op + 3);
+                if (rnd(0, 1)) firmware.back() = rnd(0, 255);
+            }
+        } else if (kind < 85) {
+            for (len = rnd(256, 2048); len > 0; len--) {
+                const char *w = words[rnd(0, 19)];
+                firmware.insert(firmware.end(), w, w + strlen(w));
+                firmware.push_back(rnd(0, 3) ? ' ' : 0);
+            }
+        } else if (kind < 95) {
+            for (len = rnd(128, 1024); len > 0; len--) firmware.push_back(rnd(0, 255));
+        } else {
+            firmware.resize(firmware.size() + rnd(64, 1024), 0);
+        }
+    }
+    firmware.resize(FIRMWARE_SIZE);
+}
+
+// gzip.compress(raw, compresslevel=9) and the manifest, as in tools/ota_pack.py
+static void packImage() {
+    z_stream z = {};
+    deflateInit2(&z, 9, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    image.resize(deflateBound(&z, firmware.size()) + 32);
+    z.next_in = firmware.data();
+    z.avail_in = firmware.size();
+    z.next_out = image.data();
+    z.avail_out = image.size();
+    deflate(&z, Z_FINISH);
+    image.resize(z.total_out);
+    deflateEnd(&z);
+
+    char line[32];
+    manifest = "size " + std::to_string(image.size()) + "\nchunk " + std::to_string(TEST_CHUNK) + "\nmd5 " +
+               std::string(32, '0') + "\n";
+    for (size_t off = 0; off < image.size(); off += TEST_CHUNK) {
+        snprintf(line, sizeof(line), "crc %08x\n", crc32(image.data() + off, min((size_t)TEST_CHUNK, image.size() - off)));
+        manifest += line;
+    }
+}
+
+// Runs the car's main loop until the update finishes or fails
+static void loopUntilDone() {
+    for (int i = 0; i < 100000 && otaInProgress(); i++) {
+        uint32_t before = fakeMicros;
+        handleOtaUpdate();
+        if (fakeMicros == before) advanceMs(10);
+    }
+}
+
+static void runUpdate() {
+    TEST_ASSERT_TRUE(startOtaUpdate("http://10.0.0.2:8000/car-fw"));
+    loopUntilDone();
+}
+
+struct Baseline {
+    uint32_t bytes;
+    uint32_t ms;
+};
+
+// Current path: the raw firmware in one stream, restarted from zero after every drop
+static Baseline singleStream() {
+    Baseline b = {0, 0};
+    uint32_t saved = fakeMicros;
+    while (true) {
+        if (!linkUp()) {
+            advanceMs(LINK_CONNECT_FAIL_MS);
+            continue;
+        }
+        streamBroken = false;
+        advanceMs(LINK_REQUEST_MS);
+        size_t got = receive(firmware.size());
+        b.bytes += got;
+        if (got == firmware.size()) break;
+    }
+    b.ms = nowMs() - saved / 1000;
+    fakeMicros = saved;
+    return b;
+}
+
+void setUp() {
+    if (firmware.empty()) {
+        buildFirmware();
+        packImage();
+    }
+    fakeMicros = 0;
+    fakeLinkUp = linkUp;
+    fakeHttpGet = serve;
+    fakeStreamRead = receive;
+    drops.clear();
+    corruptOnce.clear();
+    serveImage = true;
+    honourRange = true;
+    otaState = OTA_IDLE;
+    Update = UpdaterStub();
+    ESP.restarts = 0;
+}
+
+void tearDown() {}
+
+static void report(const char *name, const Baseline &base) {
+    char msg[200];
+    snprintf(msg, sizeof(msg), "%s: packed pull %u bytes %lu ms, raw single stream %u bytes %u ms", name,
+             bytesTransferred, finishedAt - startedAt, base.bytes, base.ms);
+    TEST_MESSAGE(msg);
+}
+
+void test_image_compresses_like_firmware() {
+    char msg[100];
+    snprintf(msg, sizeof(msg), "firmware %u bytes, packed %u bytes (%.0f%%), %u chunks", (unsigned)firmware.size(),
+             (unsigned)image.size(), 100.0 * image.size() / firmware.size(), (unsigned)(image.size() + TEST_CHUNK - 1) / TEST_CHUNK);
+    TEST_MESSAGE(msg);
+
+    // Real ESP8266 Arduino images pack to roughly 60-75%
+    TEST_ASSERT_LESS_THAN(firmware.size() * 80 / 100, image.size());
+    TEST_ASSERT_GREATER_THAN(firmware.size() * 55 / 100, image.size());
+}
+
+void test_clean_transfer() {
+    Baseline base = singleStream();
+    runUpdate();
+
+    TEST_ASSERT_EQUAL(OTA_DONE, otaState);
+    TEST_ASSERT_EQUAL(1, ESP.restarts);
+    TEST_ASSERT_TRUE(Update.committed);
+    TEST_ASSERT_TRUE(Update.image == image);
+    TEST_ASSERT_EQUAL(image.size() + manifest.size(), bytesTransferred);
+    report("clean", base);
+
+    // Two requests (manifest, image) and fewer bytes than the raw stream
+    TEST_ASSERT_LESS_THAN(base.bytes, bytesTransferred);
+    TEST_ASSERT_LESS_THAN(base.ms, finishedAt - startedAt);
+}
+
+void test_interrupted_transfer_resumes() {
+    drops = {{2000, 3000}, {9500, 1500}, {14000, 4000}, {21000, 800}};
+    Baseline base = singleStream();
+    runUpdate();
+
+    TEST_ASSERT_EQUAL(OTA_DONE, otaState);
+    TEST_ASSERT_TRUE(Update.image == image);
+    report("4 drops", base);
+
+    // Only the chunk in flight is lost per drop
+    TEST_ASSERT_LESS_OR_EQUAL(image.size() + manifest.size() + drops.size() * TEST_CHUNK, bytesTransferred);
+    TEST_ASSERT_LESS_THAN(base.bytes, bytesTransferred);
+    TEST_ASSERT_LESS_THAN(base.ms, finishedAt - startedAt);
+}
+
+// A server without Range support still works, the car reads past what it has
+void test_resume_without_range_support() {
+    honourRange = false;
+    drops = {{2000, 3000}};
+    Baseline base = singleStream();
+    runUpdate();
+
+    TEST_ASSERT_EQUAL(OTA_DONE, otaState);
+    TEST_ASSERT_TRUE(Update.image == image);
+    report("1 drop, no Range", base);
+}
+
+void test_corrupt_chunk_is_fetched_again() {
+    corruptOnce = {3, 40};
+    runUpdate();
+
+    TEST_ASSERT_EQUAL(OTA_DONE, otaState);
+    TEST_ASSERT_TRUE(Update.image == image);
+    TEST_ASSERT_EQUAL(image.size() + manifest.size() + 2 * TEST_CHUNK, bytesTransferred);
+}
+
+void test_failure_releases_without_flushing() {
+    serveImage = false;
+    runUpdate();
+
+    TEST_ASSERT_EQUAL(OTA_FAILED, otaState);
+    TEST_ASSERT_EQUAL(0, Update.partialFlushes);
+    TEST_ASSERT_FALSE(Update.isRunning());
+    TEST_ASSERT_NULL(chunkBuf);
+    TEST_ASSERT_NULL(chunkCrc);
+    TEST_ASSERT_NULL(otaStream);
+}
+
+void test_buffer_only_held_during_update() {
+    TEST_ASSERT_NULL(chunkBuf);
+    TEST_ASSERT_TRUE(startOtaUpdate("http://10.0.0.2:8000/car-fw"));
+    TEST_ASSERT_NOT_NULL(chunkBuf);
+    loopUntilDone();
+    TEST_ASSERT_EQUAL(OTA_DONE, otaState);
+    TEST_ASSERT_NULL(chunkBuf);
+    TEST_ASSERT_NULL(otaStream);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_image_compresses_like_firmware);
+    RUN_TEST(test_clean_transfer);
+    RUN_TEST(test_interrupted_transfer_resumes);
+    RUN_TEST(test_resume_without_range_support);
+    RUN_TEST(test_corrupt_chunk_is_fetched_again);
+    RUN_TEST(test_failure_releases_without_flushing);
+    RUN_TEST(test_buffer_only_held_during_update);
+    return UNITY_END();
+}
@@ -0,0 +1,235 @@
+// Runs the wheel speed loop against a simulated drivetrain: two first-order
+// motors (one weaker), a 2S battery discharging under load, encoders firing
+// the interrupt handlers, and a Ticker that fires late the way it does while
+// WiFi holds the CPU. Reports tracking error, drift over the battery run
+// against open-loop drive, and the speed measurement error against the old
+// fixed 50 ms assumption.
+//
+//   pio test -e native -f test_speed_drift -v
+
+#include <unity.h>
+
+#include "../../src/speed_control.cpp"
+
+int enA = D1, enB = D6, encAPin = 3, encBPin = 10;
+
+// Plant model
+#define SIM_STEP_US 250
+#define RUN_SECONDS 600
+#define BATTERY_FULL_MV 8400.0
+#define BATTERY_END_MV 7400.0 // Open-circuit voltage at the end of the run
+#define BATTERY_MILLIOHMS 350.0
+#define MOTOR_FULL_MA 700.0   // Per motor at full duty
+#define MOTOR_TAU_S 0.08
+#define FRICTION_TICKS 15.0   // Speed lost to friction, ticks/s
+#define WEAK_MOTOR_GAIN 0.88  // Wheel B
+#define SETTLE_US 1000000     // Excluded from error stats after a target change
+#define SEGMENT_US 20000000
+
+struct Motor {
+    double gain;
+    double speed; // ticks/s
+    double tickFraction;
+    int pwmPin;
+    int encPin;
+};
+
+struct Segment {
+    int targetA;
+    int targetB;
+};
+
+static const Segment segments[] = {{250, 250}, {150, 150}, {120, 240}, {200, 200}, {240, 120}};
+
+struct Stats {
+    double sumAbs;   // |speed - target| / target
+    double sumSq;
+    double sumSigned;
+    uint32_t samples;
+
+    void add(double speed, int target) {
+        double e = (speed - target) / target;
+        sumAbs += fabs(e);
+        sumSq += e * e;
+        sumSigned += e;
+        samples++;
+    }
+    double mean() const { return samples ? 100 * sumSigned / samples : 0; }
+    double meanAbs() const { return samples ? 100 * sumAbs / samples : 0; }
+    double rms() const { return samples ? 100 * sqrt(sumSq / samples) : 0; }
+};
+
+struct Result {
+    Stats closed;     // Both wheels, whole run
+    Stats firstMinute;
+    Stats lastMinute;
+    Stats openFirst;  // Feed-forward duty only, same plant
+    Stats openLast;
+    double measNew;   // RMS |measured - true speed|, ticks/s
+    double measOld;   // Same, with ticks * SPEED_LOOP_HZ
+    uint32_t lateTicks;
+};
+
+static uint32_t seed = 1;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi) {
+    seed = seed * 1103515245 + 12345;
+    return lo + (seed >> 8) % (hi - lo + 1);
+}
+
+static double batteryMv(uint64_t t, double loadMa) {
+    double ocv = BATTERY_FULL_MV - (BATTERY_FULL_MV - BATTERY_END_MV) * t / (RUN_SECONDS * 1000000.0);
+    return ocv - loadMa * BATTERY_MILLIOHMS / 1000;
+}
+
+static void stepMotor(Motor &m, int duty, double mv) {
+    double free = MAX_WHEEL_SPEED * m.gain * (mv / BATTERY_FULL_MV) * duty / 1023 - FRICTION_TICKS;
+    if (free < 0) free = 0;
+    m.speed += (free - m.speed) * (SIM_STEP_US / 1e6) / MOTOR_TAU_S;
+}
+
+// Moves the encoder, firing the interrupt handler for every whole tick
+static void turnEncoder(Motor &m) {
+    m.tickFraction += m.speed * SIM_STEP_US / 1e6;
+    while (m.tickFraction >= 1) {
+        m.tickFraction -= 1;
+        pinInterrupt[m.encPin & 31]();
+    }
+}
+
+static Result run(bool jitter) {
+    Result r = {};
+    fakeMicros = 0;
+    memset(pinValue, 0, sizeof(pinValue));
+    wheelA = WheelLoop();
+    wheelB = WheelLoop();
+    ticksA = ticksB = 0;
+    seed = 1;
+    initSpeedControl();
+    TEST_ASSERT_EQUAL(1000 / SPEED_LOOP_HZ, speedTicker.periodMs);
+
+    Motor a = {1.0, 0, 0, enA, encAPin};
+    Motor b = {WEAK_MOTOR_GAIN, 0, 0, enB, encBPin};
+    Motor openA = {1.0, 0, 0, 0, 0};
+    Motor openB = {WEAK_MOTOR_GAIN, 0, 0, 0, 0};
+
+    uint64_t now = 0;
+    uint64_t nominal = SPEED_PERIOD_US;
+    uint64_t fireAt = nominal;
+    uint64_t stallUntil = 0;
+    uint32_t lastTicksA = 0;
+    double measNewSq = 0, measOldSq = 0;
+    uint32_t measSamples = 0;
+    const uint64_t runUs = (uint64_t)RUN_SECONDS * 1000000;
+    const size_t segmentCount = sizeof(segments) / sizeof(segments[0]);
+
+    while (now < runUs) {
+        const Segment &seg = segments[(now / SEGMENT_US) % segmentCount];
+        setWheelTargets(seg.targetA, seg.targetB);
+
+        if (now >= fireAt) {
+            uint32_t ticks = ticksA;
+            speedTicker.callback();
+            if (ticks != lastTicksA || a.speed > 1) {
+                double oldMeasured = (double)(ticks - lastTicksA) * SPEED_LOOP_HZ;
+                measNewSq += (wheelSpeedA() - a.speed) * (wheelSpeedA() - a.speed);
+                measOldSq += (oldMeasured - a.speed) * (oldMeasured - a.speed);
+                measSamples++;
+            }
+            lastTicksA = ticks;
+
+            // os_timer keeps its schedule, but a callback cannot run while WiFi holds the CPU
+            nominal += SPEED_PERIOD_US;
+            fireAt = nominal;
+            if (jitter) {
+                fireAt += rnd(0, 15000);
+                if (rnd(0, 99) < 5) stallUntil = now + rnd(50000, 200000);
+                while (fireAt < stallUntil) {
+                    nominal += SPEED_PERIOD_US;
+                    fireAt = stallUntil;
+                }
+                if (fireAt > nominal + SPEED_PERIOD_US / 4) r.lateTicks++;
+            }
+        }
+
+        // Duty is whatever the loop last wrote; the open-loop copy gets feed-forward only
+        int dutyA = pinValue[enA & 31], dutyB = pinValue[enB & 31];
+        int ffA = min(1023L, (long)seg.targetA * SPEED_KFF >> 8), ffB = min(1023L, (long)seg.targetB * SPEED_KFF >> 8);
+        double closedMv = batteryMv(now, MOTOR_FULL_MA * (dutyA + dutyB) / 1023);
+        double openMv = batteryMv(now, MOTOR_FULL_MA * (ffA + ffB) / 1023);
+        stepMotor(a, dutyA, closedMv);
+        stepMotor(b, dutyB, closedMv);
+        stepMotor(openA, ffA, openMv);
+        stepMotor(openB, ffB, openMv);
+        turnEncoder(a);
+        turnEncoder(b);
+
+        now += SIM_STEP_US;
+        fakeMicros = (uint32_t)now;
+
+        if (now % SEGMENT_US < SETTLE_US || now % 10000) continue;
+        r.closed.add(a.speed, seg.targetA);
+        r.closed.add(b.speed, seg.targetB);
+        if (now < 60000000) {
+            r.firstMinute.add(a.speed, seg.targetA);
+            r.firstMinute.add(b.speed, seg.targetB);
+            r.openFirst.add(openA.speed, seg.targetA);
+            r.openFirst.add(openB.speed, seg.targetB);
+        } else if (now >= runUs - 60000000) {
+            r.lastMinute.add(a.speed, seg.targetA);
+            r.lastMinute.add(b.speed, seg.targetB);
+            r.openLast.add(openA.speed, seg.targetA);
+            r.openLast.add(openB.speed, seg.targetB);
+        }
+    }
+
+    r.measNew = sqrt(measNewSq / measSamples);
+    r.measOld = sqrt(measOldSq / measSamples);
+    return r;
+}
+
+static void report(const char *name, const Result &r) {
+    char msg[200];
+    snprintf(msg, sizeof(msg), "%s: tracking error mean |e| %.2f %%, rms %.2f %%; %u late ticks", name,
+             r.closed.meanAbs(), r.closed.rms(), r.lateTicks);
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "%s: drift first/last minute closed %+.2f / %+.2f %%, open loop %+.2f / %+.2f %%", name,
+             r.firstMinute.mean(), r.lastMinute.mean(), r.openFirst.mean(), r.openLast.mean());
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "%s: speed measurement rms error %.1f ticks/s (fixed 50 ms assumption: %.1f)", name,
+             r.measNew, r.measOld);
+    TEST_MESSAGE(msg);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_tracks_on_regular_ticks() {
+    Result r = run(false);
+    report("regular", r);
+
+    TEST_ASSERT_LESS_THAN(3.0, r.closed.meanAbs());
+    TEST_ASSERT_LESS_THAN(1.0, fabs(r.lastMinute.mean() - r.firstMinute.mean()));
+}
+
+void test_tracks_with_late_ticks_and_battery_drift() {
+    Result r = run(true);
+    report("late ticks", r);
+
+    TEST_ASSERT_GREATER_THAN(500, r.lateTicks);
+    TEST_ASSERT_LESS_THAN(3.0, r.closed.meanAbs());
+
+    // The battery run barely moves the closed loop, open loop loses speed
+    TEST_ASSERT_LESS_THAN(1.0, fabs(r.lastMinute.mean() - r.firstMinute.mean()));
+    TEST_ASSERT_GREATER_THAN(8.0, r.openFirst.mean() - r.openLast.mean());
+
+    // Late ticks no longer read as speed spikes
+    TEST_ASSERT_LESS_THAN(r.measOld / 3, r.measNew);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_tracks_on_regular_ticks);
+    RUN_TEST(test_tracks_with_late_ticks_and_battery_drift);
+    return UNITY_END();
+}
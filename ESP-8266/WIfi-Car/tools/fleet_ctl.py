@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""
+Drive several WIfi-Car boards at once over UDP multicast.
+
+Sends sync beacons so every car tracks this script's clock, and command packets
+that carry one entry per target plus an "apply at" time. Each car runs its own
+entry when the shared clock reaches that time, so the cars move together.
+
+Targets: a car ID (1..127), g<N> for group N, or * for every car. Commands are
+the same as the web page's State values (e, b, l, r, s, fr, fl, br, bl, f1, f0,
+0..9, q).
+
+    python3 tools/fleet_ctl.py "*:s"            # stop everything
+    python3 tools/fleet_ctl.py "1:e" "2:b" "g1:s"
+    python3 tools/fleet_ctl.py                  # interactive, one packet per line
+
+The host must be on the cars' WiFi. Check each car's sync and lateness with
+curl http://CAR_IP/fleet/status
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+GROUP = "239.0.42.10"  # FLEET_GROUP_IP in include/fleet_control.h
+PORT = 4210            # FLEET_PORT
+
+MAGIC = 0xF1EE
+VERSION = 1
+SYNC = 1
+CMD = 2
+MAX_ENTRIES = 32       # FLEET_MAX_ENTRIES in src/fleet_control.cpp
+TARGET_GROUP = 128
+
+
+def now_us():
+    return (time.monotonic_ns() // 1000) & 0xFFFFFFFF
+
+
+def parse_entry(text):
+    target, sep, cmd = text.partition(":")
+    if not sep or not 0 < len(cmd) <= 3:
+        raise ValueError("expected TARGET:CMD, got %r" % text)
+    if target == "*":
+        t = 0
+    elif target.startswith("g"):
+        t = TARGET_GROUP + int(target[1:])
+    else:
+        t = int(target)
+        if not 1 <= t <= 127:
+            raise ValueError("car ID must be 1..127")
+    if not 0 <= t <= 254:
+        raise ValueError("group must be 0..126")
+    return struct.pack("<B3s", t, cmd.encode())
+
+
+class Fleet:
+    def __init__(self, iface, ttl):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+        self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, ttl)
+        if iface:
+            self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(iface))
+        # Cars drop a command whose seq and apply-at match the last one they
+        # ran, so a fresh start must not replay the previous run's numbers
+        self.seq = random.getrandbits(16)
+        # Beacons carry it in the seq field: a car that sees a new session
+        # drops its clock estimate at once instead of waiting to be sure
+        self.session = random.randint(1, 0xFFFF)
+        self.lock = threading.Lock()
+
+    def _send(self, kind, seq, t, payload=b""):
+        packet = struct.pack("<HBBHI", MAGIC, VERSION, kind, seq, t) + payload
+        with self.lock:
+            self.sock.sendto(packet, (GROUP, PORT))
+
+    def beacon(self):
+        self._send(SYNC, self.session, now_us())
+
+    def command(self, entries, lead_ms, repeats):
+        if len(entries) > MAX_ENTRIES:
+            raise ValueError("at most %d entries per packet" % MAX_ENTRIES)
+        self.seq = (self.seq + 1) & 0xFFFF
+        apply_at = (now_us() + lead_ms * 1000) & 0xFFFFFFFF
+        payload = struct.pack("<B", len(entries)) + b"".join(entries)
+        # Repeats share the sequence number, cars run the first one they see
+        for i in range(repeats):
+            self._send(CMD, self.seq, apply_at, payload)
+            if i + 1 < repeats:
+                time.sleep(0.01)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Synchronized multicast control for WIfi-Car fleets")
+    parser.add_argument("entries", nargs="*", help="TARGET:CMD entries for a single packet")
+    parser.add_argument("--lead", type=int, default=150, help="ms between send and apply (default %(default)s)")
+    parser.add_argument("--repeats", type=int, default=3, help="copies of each command packet (default %(default)s)")
+    parser.add_argument("--beacon", type=int, default=250, help="sync beacon interval in ms (default %(default)s)")
+    parser.add_argument("--iface", help="local IP of the interface on the cars' network")
+    parser.add_argument("--ttl", type=int, default=1)
+    args = parser.parse_args()
+
+    fleet = Fleet(args.iface, args.ttl)
+
+    if args.entries:
+        # Let the cars settle on our clock before the command goes out
+        for _ in range(8):
+            fleet.beacon()
+            time.sleep(0.05)
+        fleet.command([parse_entry(e) for e in args.entries], args.lead, args.repeats)
+        return
+
+    def beacons():
+        while True:
+            fleet.beacon()
+            time.sleep(args.beacon / 1000)
+
+    threading.Thread(target=beacons, daemon=True).start()
+    print("Sending sync beacons to %s:%d, enter TARGET:CMD entries (Ctrl-D to quit)" % (GROUP, PORT))
+    for line in sys.stdin:
+        words = line.split()
+        if not words:
+            continue
+        try:
+            fleet.command([parse_entry(w) for w in words], args.lead, args.repeats)
+        except ValueError as e:
+            print("error:", e)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+Pack a WIfi-Car firmware image for the car's pull-based OTA.
+
+Compresses firmware.bin with gzip (eboot inflates it on reboot) and writes it
+as `image`, with a manifest holding the image MD5 and one CRC32 per fixed-size
+chunk. The car streams `image` in one request and checks every chunk before it
+is flashed. Serve the output directory with any static HTTP server and point
+each car at it:
+
+    python3 tools/ota_pack.py .pio/build/nodemcuv2/firmware.bin car-fw
+    python3 -m http.server 8000
+    curl "http://CAR_IP/ota?url=http://HOST_IP:8000/car-fw"
+
+After a drop the car resumes with a Range request. http.server ignores Range,
+so the car then reads the image again up to where it stopped. A server that
+supports Range (nginx, lighttpd, ...) only sends the rest.
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import zlib
+
+MAX_CHUNK = 4096  # must not exceed OTA_MAX_CHUNK in src/ota_update.cpp
+MAX_CHUNKS = 512  # OTA_MAX_CHUNKS
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a gzip-compressed OTA image with per-chunk CRCs")
+    parser.add_argument("firmware", help="firmware.bin produced by PlatformIO")
+    parser.add_argument("outdir", help="directory to write manifest and chunks into")
+    parser.add_argument("--chunk", type=int, default=MAX_CHUNK, help="bytes per CRC (default %(default)s)")
+    parser.add_argument("--no-compress", action="store_true", help="ship the raw image")
+    args = parser.parse_args()
+
+    if not 0 < args.chunk <= MAX_CHUNK:
+        parser.error("chunk size must be 1..%d" % MAX_CHUNK)
+
+    with open(args.firmware, "rb") as f:
+        raw = f.read()
+    image = raw if args.no_compress else gzip.compress(raw, compresslevel=9, mtime=0)
+
+    chunks = [image[i:i + args.chunk] for i in range(0, len(image), args.chunk)]
+    if len(chunks) > MAX_CHUNKS:
+        parser.error("image needs %d chunks, the car accepts %d" % (len(chunks), MAX_CHUNKS))
+
+    os.makedirs(args.outdir, exist_ok=True)
+    manifest = [
+        "size %d" % len(image),
+        "chunk %d" % args.chunk,
+        "md5 %s" % hashlib.md5(image).hexdigest(),
+    ]
+    for chunk in chunks:
+        manifest.append("crc %08x" % (zlib.crc32(chunk) & 0xFFFFFFFF))
+
+    with open(os.path.join(args.outdir, "image"), "wb") as f:
+        f.write(image)
+
+    with open(os.path.join(args.outdir, "manifest"), "w") as f:
+        f.write("\n".join(manifest) + "\n")
+
+    print("%s: %d -> %d bytes (%.0f%%), %d chunks" % (
+        args.firmware, len(raw), len(image), 100.0 * len(image) / len(raw), len(chunks)))
+
+
+if __name__ == "__main__":
+    main()
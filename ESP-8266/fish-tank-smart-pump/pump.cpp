@@ -7,14 +7,18 @@
  * - Runs pump for 2 minutes every 30 minutes during day cycle
  * - Runs pump for 1 minute every 60 minutes during night cycle
  * - 16-hour day cycle, 8-hour night cycle
- * - No WiFi, no external sensors
+ * - No WiFi, only a current shunt for sensing
  * - Deep sleep for power efficiency
  * - Automatic cycle reset every 24 hours
+ * - PWM soft-start and per-slot flow (duty) to avoid supply brown-outs
+ * - Pump current sensing, cuts the pump early on dry-run or stall
+ * - Energy of the last pump cycle kept in RTC memory
  * 
  * Hardware:
  * - ESP8266 GPIO2 connected to MOSFET gate (through 1kΩ resistor)
  * - MOSFET controls 3-4V pump
  * - 10kΩ pull-down resistor on MOSFET gate
+ * - 1Ω shunt between MOSFET source and GND, shunt top to A0
  */
 
 #include <ESP8266WiFi.h>
@@ -32,6 +36,33 @@
 #define NIGHT_CYCLE_DURATION (8UL * 60 * 60 * 1000)   // 8 hours
 #define TOTAL_CYCLE_DURATION (24UL * 60 * 60 * 1000)  // 24 hours
 
+// Pump drive (PWM on the MOSFET gate, 0-1023)
+#define PUMP_PWM_FREQ    1000  // Hz
+#define DAY_PUMP_DUTY    1023  // Full flow during the day
+#define NIGHT_PUMP_DUTY  700   // Gentler flow at night
+#define SOFT_START_MS    1500  // Ramp time from 0 to the slot duty
+#define SOFT_START_STEPS 30
+
+// Current sensing through the shunt on A0
+#define SHUNT_MILLIOHMS    1000  // 1Ω shunt
+#define ADC_FULL_SCALE_MV  3200  // NodeMCU A0 divider, use 1000 on a bare ESP-12
+#define PUMP_SUPPLY_MV     3700  // Used for the energy estimate
+#define CURRENT_BATCH      16    // ADC reads averaged per sample
+#define CURRENT_SAMPLE_MS  100   // Time between batches
+#define CURRENT_FILTER_SHIFT 3   // Low-pass weight 1/8 per sample
+
+// Fault detection, thresholds are for full duty and scale with the slot duty
+#define PUMP_SETTLE_MS     3000  // Ignore inrush and priming after soft-start
+#define DRY_RUN_MA         60    // Below this the pump is running dry
+#define STALL_MA           600   // Above this the impeller is blocked
+#define FAULT_CONFIRM_MS   2000  // Condition must hold this long before cutting
+
+enum PumpFault : uint8_t {
+  PUMP_OK = 0,
+  PUMP_DRY_RUN = 1,
+  PUMP_STALL = 2
+};
+
 // Deep sleep durations (in microseconds)
 #define SLEEP_30_MIN (30UL * 60 * 1000000)  // 30 minutes
 #define SLEEP_60_MIN (60UL * 60 * 1000000)  // 60 minutes
@@ -44,10 +75,15 @@ struct {
   uint32_t lastPumpTime;
   uint16_t bootCount;
   bool isFirstBoot;
+  uint8_t lastFault;          // PumpFault of the last pump cycle
+  uint32_t lastCycleEnergyMj; // Energy of the last pump cycle in mJ
+  uint32_t totalEnergyMj;     // Since first boot
 } rtcData;
 
 // Function prototypes
-void runPump(unsigned long duration);
+void runPump(unsigned long duration, uint16_t duty);
+void setPumpDuty(uint16_t duty);
+uint16_t readPumpCurrent();
 void enterDeepSleep(unsigned long sleepTime);
 uint32_t calculateCRC32(const uint8_t *data, size_t length);
 bool readRTCMemory();
@@ -65,6 +101,8 @@ void setup() {
   // Initialize pins
   pinMode(PUMP_PIN, OUTPUT);
   pinMode(LED_PIN, OUTPUT);
+  analogWriteRange(1023);
+  analogWriteFreq(PUMP_PWM_FREQ);
   digitalWrite(PUMP_PIN, LOW);  // Pump off initially
   digitalWrite(LED_PIN, LOW);   // LED off initially
   
@@ -78,6 +116,9 @@ void setup() {
     rtcData.lastPumpTime = 0;
     rtcData.bootCount = 1;
     rtcData.isFirstBoot = true;
+    rtcData.lastFault = PUMP_OK;
+    rtcData.lastCycleEnergyMj = 0;
+    rtcData.totalEnergyMj = 0;
     writeRTCMemory();
   } else {
     rtcData.bootCount++;
@@ -93,13 +134,14 @@ void setup() {
   unsigned long timeSinceLastPump = currentCycleTime - rtcData.lastPumpTime;
   unsigned long pumpInterval = dayTime ? DAY_PUMP_INTERVAL : NIGHT_PUMP_INTERVAL;
   unsigned long pumpDuration = dayTime ? DAY_PUMP_DURATION : NIGHT_PUMP_DURATION;
+  uint16_t pumpDuty = dayTime ? DAY_PUMP_DUTY : NIGHT_PUMP_DUTY;
   
   // Check if it's time to run the pump
   if (rtcData.isFirstBoot || timeSinceLastPump >= pumpInterval) {
     // Time to run the pump
     blinkStatus(dayTime ? 2 : 1);  // 2 blinks for day, 1 for night
     
-    runPump(pumpDuration);
+    runPump(pumpDuration, pumpDuty);
     
     // Update last pump time
     rtcData.lastPumpTime = getCurrentCycleTime();
@@ -122,29 +164,97 @@ void loop() {
   delay(1000);
 }
 
-void runPump(unsigned long duration) {
-  // Turn on pump
-  digitalWrite(PUMP_PIN, HIGH);
+void runPump(unsigned long duration, uint16_t duty) {
   digitalWrite(LED_PIN, HIGH);  // LED on during pump operation
+  uint64_t energyNj = 0;
+  
+  // Soft-start: ramp the duty up so the inrush doesn't brown out the ESP.
+  // Current is sampled every step, the inrush belongs in the cycle's energy.
+  for (int step = 1; step <= SOFT_START_STEPS; step++) {
+    setPumpDuty((uint32_t)duty * step / SOFT_START_STEPS);
+    uint16_t stepStartMa = readPumpCurrent();  // Peak right after the duty goes up
+    delay(SOFT_START_MS / SOFT_START_STEPS);
+    energyNj += (uint64_t)PUMP_SUPPLY_MV * (stepStartMa + readPumpCurrent()) / 2 * (SOFT_START_MS / SOFT_START_STEPS);
+  }
   
-  // Run for specified duration with periodic status checks
+  // Expected current scales with duty
+  uint16_t dryRunMa = (uint32_t)DRY_RUN_MA * duty / 1023;
+  uint16_t stallMa = (uint32_t)STALL_MA * duty / 1023;
+  
+  // Run for specified duration, sampling current in batches
+  uint32_t filtered = (uint32_t)readPumpCurrent() << CURRENT_FILTER_SHIFT;
+  unsigned long faultSince = 0;
+  unsigned long lastBlink = millis();
+  uint8_t fault = PUMP_OK;
   unsigned long startTime = millis();
   while (millis() - startTime < duration) {
-    delay(5000);  // Check every 5 seconds
-    // Toggle LED to show activity
-    digitalWrite(LED_PIN, !digitalRead(LED_PIN));
+    delay(CURRENT_SAMPLE_MS);
+    
+    // Integer low-pass: filtered holds mA << CURRENT_FILTER_SHIFT
+    uint16_t sampleMa = readPumpCurrent();
+    filtered -= filtered >> CURRENT_FILTER_SHIFT;
+    filtered += sampleMa;
+    uint16_t currentMa = filtered >> CURRENT_FILTER_SHIFT;
+    
+    // mV * mA = uW, uW * ms = nJ
+    energyNj += (uint64_t)PUMP_SUPPLY_MV * sampleMa * CURRENT_SAMPLE_MS;
+    
+    if (millis() - startTime > PUMP_SETTLE_MS) {
+      uint8_t condition = currentMa < dryRunMa ? PUMP_DRY_RUN : currentMa > stallMa ? PUMP_STALL : PUMP_OK;
+      if (condition == PUMP_OK) {
+        faultSince = 0;
+      } else if (faultSince == 0) {
+        faultSince = millis();
+      } else if (millis() - faultSince >= FAULT_CONFIRM_MS) {
+        fault = condition;
+        break;
+      }
+    }
+    
+    // Toggle LED every 5 seconds to show activity
+    if (millis() - lastBlink >= 5000) {
+      lastBlink = millis();
+      digitalWrite(LED_PIN, !digitalRead(LED_PIN));
+    }
   }
   
   // Turn off pump
-  digitalWrite(PUMP_PIN, LOW);
+  setPumpDuty(0);
   digitalWrite(LED_PIN, LOW);
   
+  rtcData.lastFault = fault;
+  rtcData.lastCycleEnergyMj = energyNj / 1000000;
+  rtcData.totalEnergyMj += rtcData.lastCycleEnergyMj;
+  
+  if (fault != PUMP_OK) {
+    blinkStatus(fault == PUMP_DRY_RUN ? 5 : 8);  // 5 blinks dry-run, 8 blinks stall
+  }
+  
   delay(1000);  // Brief delay after pump operation
 }
 
+void setPumpDuty(uint16_t duty) {
+  if (duty == 0) {
+    analogWrite(PUMP_PIN, 0);
+    digitalWrite(PUMP_PIN, LOW);
+  } else {
+    analogWrite(PUMP_PIN, duty);
+  }
+}
+
+// Average of one ADC batch, in mA through the shunt
+uint16_t readPumpCurrent() {
+  uint32_t sum = 0;
+  for (int i = 0; i < CURRENT_BATCH; i++) {
+    sum += analogRead(A0);
+  }
+  uint32_t mv = sum * ADC_FULL_SCALE_MV / (1023UL * CURRENT_BATCH);
+  return mv * 1000 / SHUNT_MILLIOHMS;
+}
+
 void enterDeepSleep(unsigned long sleepTime) {
   // Ensure pins are in correct state before sleep
-  digitalWrite(PUMP_PIN, LOW);
+  setPumpDuty(0);
   digitalWrite(LED_PIN, LOW);
   
   // Enter deep sleep
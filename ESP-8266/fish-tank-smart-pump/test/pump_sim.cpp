@@ -0,0 +1,161 @@
+// Host simulation of runPump() against synthetic pump current traces.
+//
+// A small DC motor model (speed lags the PWM duty, current falls as the motor
+// spins up) feeds A0. Each scenario checks the fault detection and its delay,
+// and compares the cycle energy against what the motor actually drew and
+// against the old always-on drive (gate high for the full slot).
+//
+//   g++ -std=gnu++17 -I test/stubs test/pump_sim.cpp -o pump_sim && ./pump_sim
+
+#include <cmath>
+#include <cstdio>
+
+#include "../pump.cpp"
+
+// Motor model, currents at full duty
+#define MODEL_STALL_MA 1200.0 // Locked rotor
+#define MODEL_LOAD_MA 250.0   // Pumping water
+#define MODEL_DRY_MA 30.0     // Spinning in air
+#define MODEL_TAU_MS 300.0    // Spin-up time constant
+#define MODEL_NOISE_MA 15
+
+enum Condition { NORMAL, DRY, STALLED };
+
+struct Scenario {
+  const char *name;
+  unsigned long duration;
+  uint16_t duty;
+  Condition fault;     // Condition after faultAt
+  unsigned long faultAt; // ms after the pump starts
+  uint8_t expected;
+};
+
+static unsigned long nowMs = 0;
+static double duty = 0, speed = 0;
+static Condition condition = NORMAL;
+static double currentMa = 0, peakMa = 0, energyMj = 0; // peakMa covers start-up only
+static unsigned long pumpStart = 0, pumpStop = 0;
+static const Scenario *active = nullptr;
+static uint32_t noiseSeed = 1;
+
+static double modelCurrent() {
+  double load = condition == DRY ? MODEL_DRY_MA : MODEL_LOAD_MA;
+  double i = condition == STALLED ? MODEL_STALL_MA * duty : MODEL_STALL_MA * (duty - speed) + load * speed;
+  return i > 0 ? i : 0;
+}
+
+void simAdvanceMs(unsigned long ms) {
+  for (unsigned long i = 0; i < ms; i++) {
+    nowMs++;
+    if (active && pumpStart && nowMs - pumpStart >= active->faultAt) condition = active->fault;
+    speed = condition == STALLED ? 0 : speed + (duty - speed) / MODEL_TAU_MS;
+    currentMa = modelCurrent();
+    if (currentMa > peakMa && nowMs - pumpStart < SOFT_START_MS + 500) peakMa = currentMa;
+    energyMj += PUMP_SUPPLY_MV / 1000.0 * currentMa / 1000.0; // W over 1 ms = mJ
+  }
+}
+
+unsigned long simMillis() { return nowMs; }
+
+int simAnalogRead() {
+  noiseSeed = noiseSeed * 1103515245 + 12345;
+  double noise = (int)((noiseSeed >> 16) % (2 * MODEL_NOISE_MA + 1)) - MODEL_NOISE_MA;
+  double mv = (currentMa + noise) * SHUNT_MILLIOHMS / 1000.0;
+  int counts = lround(mv * 1023 / ADC_FULL_SCALE_MV);
+  return counts < 0 ? 0 : counts > 1023 ? 1023 : counts;
+}
+
+void simSetDuty(int value) {
+  if (value > 0 && duty == 0 && !pumpStart) pumpStart = nowMs;
+  if (value == 0 && duty > 0 && pumpStart && !pumpStop) pumpStop = nowMs;
+  duty = value / 1023.0;
+  currentMa = modelCurrent(); // Winding inductance is negligible at this scale
+}
+
+static void reset(const Scenario *s) {
+  nowMs = 1000;
+  duty = speed = 0;
+  condition = s && s->faultAt == 0 ? s->fault : NORMAL;
+  currentMa = peakMa = energyMj = 0;
+  pumpStart = pumpStop = 0;
+  active = s;
+  memset(&rtcData, 0, sizeof(rtcData));
+}
+
+struct AlwaysOn {
+  double energyMj;
+  double peakMa;
+};
+
+// The drive before soft-start: gate high for the whole slot, no cut-off
+static AlwaysOn alwaysOn(const Scenario &s) {
+  reset(&s);
+  simSetDuty(1023);
+  simAdvanceMs(s.duration);
+  simSetDuty(0);
+  return {energyMj, peakMa};
+}
+
+static int failures = 0;
+
+#define CHECK(cond, ...)          \
+  do {                            \
+    if (!(cond)) {                \
+      printf("  FAIL: " __VA_ARGS__); \
+      printf("\n");               \
+      failures++;                 \
+    }                             \
+  } while (0)
+
+static void runScenario(const Scenario &s) {
+  AlwaysOn base = alwaysOn(s);
+
+  reset(&s);
+  runPump(s.duration, s.duty);
+  double actualMj = energyMj;
+  long detectMs = s.expected == PUMP_OK ? -1 : (long)(pumpStop - pumpStart) - (long)s.faultAt;
+
+  printf("%-22s fault %u  detect %6ld ms  run %6lu ms  energy %6u mJ (actual %6.0f)  always-on %6.0f mJ  inrush %4.0f / %4.0f mA\n",
+         s.name, rtcData.lastFault, detectMs, pumpStop - pumpStart, rtcData.lastCycleEnergyMj, actualMj,
+         base.energyMj, peakMa, base.peakMa);
+
+  CHECK(rtcData.lastFault == s.expected, "expected fault %u", s.expected);
+  if (s.expected != PUMP_OK) {
+    // Settle time applies when the fault is there from the start
+    long limit = FAULT_CONFIRM_MS + 1500 + (s.faultAt < SOFT_START_MS + PUMP_SETTLE_MS ? SOFT_START_MS + PUMP_SETTLE_MS : 0);
+    CHECK(detectMs >= 0 && detectMs <= limit, "detected after %ld ms, limit %ld", detectMs, limit);
+  } else {
+    CHECK(pumpStop - pumpStart >= s.duration, "pump stopped early");
+  }
+  CHECK(fabs(rtcData.lastCycleEnergyMj - actualMj) <= actualMj * 0.05 + 1, "energy off by more than 5%%");
+  CHECK(peakMa < base.peakMa * 0.5, "soft-start inrush not below half of always-on");
+}
+
+// Soft-start alone: a zero-length run only counts the ramp
+static void rampEnergy() {
+  Scenario s = {"ramp only", 0, DAY_PUMP_DUTY, NORMAL, 0, PUMP_OK};
+  reset(&s);
+  runPump(0, DAY_PUMP_DUTY);
+  double rampMj = energyMj;
+  printf("%-22s energy %u mJ (actual %.0f)\n", s.name, rtcData.lastCycleEnergyMj, rampMj);
+  CHECK(rtcData.lastCycleEnergyMj > 0, "ramp energy not counted");
+  CHECK(fabs(rtcData.lastCycleEnergyMj - rampMj) <= rampMj * 0.15, "ramp energy off by more than 15%%");
+}
+
+int main() {
+  static const Scenario scenarios[] = {
+      {"day, normal", DAY_PUMP_DURATION, DAY_PUMP_DUTY, NORMAL, 0, PUMP_OK},
+      {"night, normal", NIGHT_PUMP_DURATION, NIGHT_PUMP_DUTY, NORMAL, 0, PUMP_OK},
+      {"day, dry at 20 s", DAY_PUMP_DURATION, DAY_PUMP_DUTY, DRY, 20000, PUMP_DRY_RUN},
+      {"day, dry from start", DAY_PUMP_DURATION, DAY_PUMP_DUTY, DRY, 0, PUMP_DRY_RUN},
+      {"day, stall at 30 s", DAY_PUMP_DURATION, DAY_PUMP_DUTY, STALLED, 30000, PUMP_STALL},
+      {"night, dry at 10 s", NIGHT_PUMP_DURATION, NIGHT_PUMP_DUTY, DRY, 10000, PUMP_DRY_RUN},
+      {"night, stall at 40 s", NIGHT_PUMP_DURATION, NIGHT_PUMP_DUTY, STALLED, 40000, PUMP_STALL},
+  };
+
+  for (const Scenario &s : scenarios) runScenario(s);
+  rampEnergy();
+
+  printf(failures ? "%d check(s) failed\n" : "all checks passed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+// Host stand-in for the ESP8266 core pieces pump.cpp uses. Time is simulated
+// and A0 reads come from the motor model in pump_sim.cpp.
+#ifndef STUB_ESP8266WIFI_H
+#define STUB_ESP8266WIFI_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+using std::min;
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+#define A0 17
+#define WIFI_OFF 0
+#define WAKE_RF_DISABLED 4
+
+// Provided by the simulation
+void simAdvanceMs(unsigned long ms);
+unsigned long simMillis();
+int simAnalogRead();
+void simSetDuty(int duty);
+
+inline unsigned long millis() { return simMillis(); }
+inline void delay(unsigned long ms) { simAdvanceMs(ms); }
+
+inline int pinState[32];
+inline void pinMode(int, int) {}
+inline void digitalWrite(int pin, int value) {
+  pinState[pin & 31] = value;
+  if (pin == 2 && value == LOW) simSetDuty(0);
+}
+inline int digitalRead(int pin) { return pinState[pin & 31]; }
+inline void analogWrite(int pin, int value) {
+  if (pin == 2) simSetDuty(value);
+}
+inline void analogWriteRange(int) {}
+inline void analogWriteFreq(int) {}
+inline int analogRead(int) { return simAnalogRead(); }
+
+struct WiFiStub {
+  void mode(int) {}
+  void forceSleepBegin() {}
+};
+inline WiFiStub WiFi;
+
+struct EspStub {
+  uint32_t rtc[64];
+  bool rtcValid = false;
+  bool rtcUserMemoryRead(uint32_t, uint32_t *data, size_t size) {
+    if (!rtcValid) return false;
+    memcpy(data, rtc, size);
+    return true;
+  }
+  bool rtcUserMemoryWrite(uint32_t, uint32_t *data, size_t size) {
+    memcpy(rtc, data, size);
+    rtcValid = true;
+    return true;
+  }
+  void deepSleep(uint64_t, int) {}
+};
+inline EspStub ESP;
+
+#endif